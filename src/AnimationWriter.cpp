@@ -0,0 +1,352 @@
+#include "AnimationWriter.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+
+static const uchar PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+static uint32_t crc32Update(uint32_t crc, const uchar* data, size_t length) {
+    static uint32_t table[256];
+    static bool tableReady = [] {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)tableReady;
+
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void putUint32BE(vector<uchar>& buffer, uint32_t value) {
+    buffer.push_back(static_cast<uchar>(value >> 24));
+    buffer.push_back(static_cast<uchar>(value >> 16));
+    buffer.push_back(static_cast<uchar>(value >> 8));
+    buffer.push_back(static_cast<uchar>(value));
+}
+
+static void putUint16BE(vector<uchar>& buffer, uint16_t value) {
+    buffer.push_back(static_cast<uchar>(value >> 8));
+    buffer.push_back(static_cast<uchar>(value));
+}
+
+static void putUint24LE(vector<uchar>& buffer, uint32_t value) {
+    buffer.push_back(static_cast<uchar>(value));
+    buffer.push_back(static_cast<uchar>(value >> 8));
+    buffer.push_back(static_cast<uchar>(value >> 16));
+}
+
+static void putUint32LE(vector<uchar>& buffer, uint32_t value) {
+    putUint24LE(buffer, value);
+    buffer.push_back(static_cast<uchar>(value >> 24));
+}
+
+static uint32_t readUint32BE(const uchar* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static uint32_t readUint32LE(const uchar* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static Mat toBgr(const Mat& frame) {
+    if (frame.channels() == 3) return frame;
+
+    Mat bgr;
+    cvtColor(frame, bgr, frame.channels() == 4 ? COLOR_BGRA2BGR : COLOR_GRAY2BGR);
+    return bgr;
+}
+
+Rect AnimationWriter::changedRegion(const Mat& frame) const {
+    if (previousFrame.empty() || previousFrame.size() != frame.size()) {
+        return Rect(0, 0, frame.cols, frame.rows);
+    }
+
+    const size_t rowBytes = static_cast<size_t>(frame.cols) * 3;
+    int minX = frame.cols, maxX = -1, minY = -1, maxY = -1;
+
+    for (int y = 0; y < frame.rows; y++) {
+        const uchar* current = frame.ptr<uchar>(y);
+        const uchar* previous = previousFrame.ptr<uchar>(y);
+        if (memcmp(current, previous, rowBytes) == 0) continue;
+
+        size_t first = 0;
+        while (current[first] == previous[first]) first++;
+        size_t last = rowBytes - 1;
+        while (current[last] == previous[last]) last--;
+
+        minX = std::min(minX, static_cast<int>(first / 3));
+        maxX = std::max(maxX, static_cast<int>(last / 3));
+        if (minY < 0) minY = y;
+        maxY = y;
+    }
+
+    if (maxY < 0) return Rect();
+    return Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+}
+
+void ApngWriter::writeChunk(const char type[4], const vector<uchar>& data) {
+    vector<uchar> header;
+    putUint32BE(header, static_cast<uint32_t>(data.size()));
+
+    uint32_t crc = crc32Update(0xFFFFFFFFu, reinterpret_cast<const uchar*>(type), 4);
+    crc = crc32Update(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+    vector<uchar> trailer;
+    putUint32BE(trailer, crc);
+
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    out.write(type, 4);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    out.write(reinterpret_cast<const char*>(trailer.data()), trailer.size());
+}
+
+bool ApngWriter::open(const string& path, Size size, int fps) {
+    out.open(path, ios::binary | ios::trunc);
+    if (!out.is_open()) return false;
+
+    canvasSize = size;
+    frameRate = std::max(1, std::min(fps, 65535));
+    frameCount = 0;
+    sequenceNumber = 0;
+    previousFrame.release();
+
+    out.write(reinterpret_cast<const char*>(PNG_SIGNATURE), sizeof(PNG_SIGNATURE));
+
+    vector<uchar> ihdr;
+    putUint32BE(ihdr, canvasSize.width);
+    putUint32BE(ihdr, canvasSize.height);
+    ihdr.push_back(8);  // bit depth
+    ihdr.push_back(2);  // truecolor, same as what imencode produces for 8UC3
+    ihdr.push_back(0);
+    ihdr.push_back(0);
+    ihdr.push_back(0);
+    writeChunk("IHDR", ihdr);
+
+    // Frame count is unknown while streaming; patched in close()
+    actlPosition = out.tellp();
+    vector<uchar> actl;
+    putUint32BE(actl, 0);
+    putUint32BE(actl, 0);   // loop forever
+    writeChunk("acTL", actl);
+
+    return out.good();
+}
+
+bool ApngWriter::addFrame(const Mat& input) {
+    if (!out.is_open()) return false;
+
+    Mat frame = toBgr(input);
+    if (frame.size() != canvasSize) return false;
+
+    Rect region = changedRegion(frame);
+    if (region.empty()) {
+        region = Rect(0, 0, 1, 1);  // APNG has no empty frames
+    }
+
+    vector<uchar> png;
+    if (!imencode(".png", frame(region), png, {IMWRITE_PNG_COMPRESSION, 6}) || png.size() < 8) {
+        return false;
+    }
+
+    vector<uchar> fctl;
+    putUint32BE(fctl, sequenceNumber++);
+    putUint32BE(fctl, region.width);
+    putUint32BE(fctl, region.height);
+    putUint32BE(fctl, region.x);
+    putUint32BE(fctl, region.y);
+    putUint16BE(fctl, 1);
+    putUint16BE(fctl, static_cast<uint16_t>(frameRate));
+    fctl.push_back(0);  // dispose: none
+    fctl.push_back(0);  // blend: source
+    writeChunk("fcTL", fctl);
+
+    // Move the IDAT payload of the encoded PNG into this animation
+    size_t pos = 8;
+    while (pos + 12 <= png.size()) {
+        uint32_t length = readUint32BE(&png[pos]);
+        const char* type = reinterpret_cast<const char*>(&png[pos + 4]);
+        if (pos + 12 + length > png.size()) return false;
+
+        if (memcmp(type, "IDAT", 4) == 0) {
+            if (frameCount == 0) {
+                writeChunk("IDAT", vector<uchar>(png.begin() + pos + 8, png.begin() + pos + 8 + length));
+            } else {
+                vector<uchar> fdat;
+                fdat.reserve(length + 4);
+                putUint32BE(fdat, sequenceNumber++);
+                fdat.insert(fdat.end(), png.begin() + pos + 8, png.begin() + pos + 8 + length);
+                writeChunk("fdAT", fdat);
+            }
+        }
+        pos += 12 + length;
+    }
+
+    if (previousFrame.empty()) {
+        frame.copyTo(previousFrame);
+    } else {
+        frame(region).copyTo(previousFrame(region));
+    }
+
+    frameCount++;
+    return out.good();
+}
+
+bool ApngWriter::close() {
+    if (!out.is_open()) return false;
+
+    writeChunk("IEND", vector<uchar>());
+
+    streampos endPosition = out.tellp();
+    out.seekp(actlPosition);
+    vector<uchar> actl;
+    putUint32BE(actl, frameCount);
+    putUint32BE(actl, 0);
+    writeChunk("acTL", actl);
+    out.seekp(endPosition);
+
+    bool ok = out.good() && frameCount > 0;
+    out.close();
+    previousFrame.release();
+    return ok;
+}
+
+void WebpAnimationWriter::writeChunk(const char type[4], const vector<uchar>& data) {
+    vector<uchar> header;
+    putUint32LE(header, static_cast<uint32_t>(data.size()));
+
+    out.write(type, 4);
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (data.size() % 2 == 1) {
+        out.put(0);
+    }
+}
+
+bool WebpAnimationWriter::open(const string& path, Size size, int fps) {
+    if (!haveImageWriter(".webp")) {
+        cout << "This OpenCV build has no WebP encoder." << endl;
+        return false;
+    }
+
+    out.open(path, ios::binary | ios::trunc);
+    if (!out.is_open()) return false;
+
+    canvasSize = size;
+    frameRate = std::max(1, fps);
+    frameCount = 0;
+    previousFrame.release();
+
+    // RIFF size is patched in close()
+    out.write("RIFF\0\0\0\0WEBP", 12);
+
+    vector<uchar> vp8x;
+    vp8x.push_back(0x02);   // animation
+    vp8x.push_back(0);
+    vp8x.push_back(0);
+    vp8x.push_back(0);
+    putUint24LE(vp8x, canvasSize.width - 1);
+    putUint24LE(vp8x, canvasSize.height - 1);
+    writeChunk("VP8X", vp8x);
+
+    vector<uchar> anim;
+    anim.push_back(0);      // background BGRA
+    anim.push_back(0);
+    anim.push_back(0);
+    anim.push_back(255);
+    anim.push_back(0);      // loop forever
+    anim.push_back(0);
+    writeChunk("ANIM", anim);
+
+    return out.good();
+}
+
+bool WebpAnimationWriter::addFrame(const Mat& input) {
+    if (!out.is_open()) return false;
+
+    Mat frame = toBgr(input);
+    if (frame.size() != canvasSize) return false;
+
+    Rect region = changedRegion(frame);
+    if (region.empty()) {
+        region = Rect(0, 0, 1, 1);
+    }
+
+    // ANMF offsets are stored halved, so the rectangle has to start on even coordinates
+    int x0 = region.x & ~1;
+    int y0 = region.y & ~1;
+    region = Rect(x0, y0, region.x + region.width - x0, region.y + region.height - y0);
+
+    vector<uchar> webp;
+    if (!imencode(".webp", frame(region), webp, {IMWRITE_WEBP_QUALITY, quality}) || webp.size() < 12) {
+        return false;
+    }
+
+    vector<uchar> anmf;
+    putUint24LE(anmf, region.x / 2);
+    putUint24LE(anmf, region.y / 2);
+    putUint24LE(anmf, region.width - 1);
+    putUint24LE(anmf, region.height - 1);
+    putUint24LE(anmf, std::max(1, 1000 / frameRate));
+    anmf.push_back(0x02);   // no blending, no disposal
+
+    // Copy the bitstream chunks (VP8/VP8L/ALPH) of the encoded still image
+    size_t pos = 12;
+    while (pos + 8 <= webp.size()) {
+        uint32_t length = readUint32LE(&webp[pos + 4]);
+        size_t padded = length + (length % 2);
+        if (pos + 8 + length > webp.size()) return false;
+
+        if (memcmp(&webp[pos], "VP8X", 4) != 0) {
+            anmf.insert(anmf.end(), webp.begin() + pos, webp.begin() + pos + 8 + length);
+            if (length % 2 == 1) anmf.push_back(0);
+        }
+        pos += 8 + padded;
+    }
+
+    writeChunk("ANMF", anmf);
+
+    if (previousFrame.empty()) {
+        frame.copyTo(previousFrame);
+    } else {
+        frame(region).copyTo(previousFrame(region));
+    }
+
+    frameCount++;
+    return out.good();
+}
+
+bool WebpAnimationWriter::close() {
+    if (!out.is_open()) return false;
+
+    streampos endPosition = out.tellp();
+    vector<uchar> riffSize;
+    putUint32LE(riffSize, static_cast<uint32_t>(static_cast<streamoff>(endPosition) - 8));
+    out.seekp(4);
+    out.write(reinterpret_cast<const char*>(riffSize.data()), riffSize.size());
+    out.seekp(endPosition);
+
+    bool ok = out.good() && frameCount > 0;
+    out.close();
+    previousFrame.release();
+    return ok;
+}
+
+unique_ptr<AnimationWriter> createAnimationWriter(const string& path) {
+    string extension = std::filesystem::path(path).extension().string();
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == ".png" || extension == ".apng") {
+        return unique_ptr<AnimationWriter>(new ApngWriter());
+    }
+    if (extension == ".webp") {
+        return unique_ptr<AnimationWriter>(new WebpAnimationWriter());
+    }
+    return nullptr;
+}
@@ -0,0 +1,74 @@
+#ifndef ANIMATION_WRITER_HPP
+#define ANIMATION_WRITER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <cstdint>
+
+using namespace cv;
+using namespace std;
+
+// Streaming animation encoder: frames are encoded as soon as they arrive and only the
+// previous frame is kept, to find the rectangle that changed since then.
+class AnimationWriter {
+protected:
+    ofstream out;
+    Mat previousFrame;
+    Size canvasSize;
+    int frameRate;
+    uint32_t frameCount;
+
+    // Bounding box of the pixels that differ from previousFrame (full canvas for frame 0)
+    Rect changedRegion(const Mat& frame) const;
+
+public:
+    AnimationWriter() : frameRate(3), frameCount(0) {}
+    virtual ~AnimationWriter() {}
+
+    virtual bool open(const string& path, Size size, int fps) = 0;
+    virtual bool addFrame(const Mat& frame) = 0;
+    virtual bool close() = 0;
+
+    uint32_t getFrameCount() const { return frameCount; }
+};
+
+// Animated PNG: every frame is a 24-bit PNG of the changed rectangle, re-chunked as fdAT
+class ApngWriter : public AnimationWriter {
+private:
+    uint32_t sequenceNumber;
+    streampos actlPosition;
+
+    void writeChunk(const char type[4], const vector<uchar>& data);
+
+public:
+    ApngWriter() : sequenceNumber(0) {}
+    ~ApngWriter() override { if (out.is_open()) close(); }
+
+    bool open(const string& path, Size size, int fps) override;
+    bool addFrame(const Mat& frame) override;
+    bool close() override;
+};
+
+// Animated WebP: every frame is a lossless VP8L bitstream of the changed rectangle in an ANMF chunk
+class WebpAnimationWriter : public AnimationWriter {
+private:
+    int quality;    // > 100 selects lossless
+
+    void writeChunk(const char type[4], const vector<uchar>& data);
+
+public:
+    WebpAnimationWriter(int quality = 101) : quality(quality) {}
+    ~WebpAnimationWriter() override { if (out.is_open()) close(); }
+
+    bool open(const string& path, Size size, int fps) override;
+    bool addFrame(const Mat& frame) override;
+    bool close() override;
+};
+
+// Picks the writer from the extension (.png/.apng or .webp), nullptr otherwise
+unique_ptr<AnimationWriter> createAnimationWriter(const string& path);
+
+#endif
@@ -0,0 +1,129 @@
+#include "BatchCompressor.hpp"
+#include "ImageLoader.hpp"
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+BatchCompressor::BatchCompressor(const BatchSettings& settings, int workers) : settings(settings) {
+    if (workers <= 0) {
+        workers = static_cast<int>(thread::hardware_concurrency());
+    }
+    arenas.resize(std::max(1, workers));
+}
+
+BatchResult BatchCompressor::compressOne(const BatchJob& job, BuildArena& arena, const CancellationToken* token) {
+    BatchResult result;
+    auto start = chrono::steady_clock::now();
+
+    ImageProbe probe;
+    if (!probeImage(job.inputPath, probe, result.error)) {
+        return result;
+    }
+
+    // File bytes and pixels both land in arena buffers of the worker
+    ifstream file(job.inputPath, ios::binary | ios::ate);
+    streamoff length = file.is_open() ? static_cast<streamoff>(file.tellg()) : -1;
+    if (length <= 0) {
+        result.error = "cannot read " + job.inputPath;
+        return result;
+    }
+    arena.encoded.resize(static_cast<size_t>(length));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(arena.encoded.data()), length);
+    if (file.gcount() != length) {
+        result.error = "cannot read " + job.inputPath;
+        return result;
+    }
+
+    // imdecode writes into a buffer of the right size and type in place; an EXIF rotation
+    // changes the size and simply gets a buffer of its own
+    Mat image = arena.decoded.view(probe.size, CV_8UC3);
+    imdecode(arena.encoded, IMREAD_COLOR, &image);
+    if (image.empty()) {
+        result.error = "cannot decode " + job.inputPath;
+        return result;
+    }
+    result.size = image.size();
+
+    arena.reset();
+    Quadtree quadtree(image, settings.threshold, settings.minBlockSize, settings.method,
+                      settings.targetCompressionPct, false, &arena);
+    quadtree.setBuildStrategy(settings.strategy);
+    quadtree.setPaletteSize(settings.paletteSize);
+    quadtree.setLossless(settings.lossless);
+    quadtree.setCancellationToken(token);
+    quadtree.compressImage();
+
+    if (quadtree.wasCancelled()) {
+        result.error = "cancelled";
+        return result;
+    }
+
+    bool written;
+    if (fs::path(job.outputPath).extension() == ".qtc") {
+        written = quadtree.saveContainer(job.outputPath);
+    } else {
+        Mat reconstruction = arena.reconstruction.view(image.size(), image.type());
+        quadtree.reconstructImage(reconstruction);
+        written = imwrite(job.outputPath, reconstruction);
+    }
+    if (!written) {
+        result.error = "cannot write " + job.outputPath;
+        return result;
+    }
+
+    result.ok = true;
+    result.leaves = quadtree.getLeafCount();
+    result.psnr = quadtree.hasCompleteDistortion() ? quadtree.getBuildPsnr() : 0.0;
+    result.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+vector<BatchResult> BatchCompressor::run(const vector<BatchJob>& jobs, const CancellationToken* token,
+                                         BatchProgress progress) {
+    vector<BatchResult> results(jobs.size());
+    atomic<size_t> nextJob(0);
+    atomic<int> finished(0);
+    mutex progressMutex;
+
+    // Workers pull the next job as they finish, so large and small images even out
+    int workers = static_cast<int>(std::min(arenas.size(), jobs.size()));
+    vector<thread> threads;
+    for (int w = 0; w < workers; w++) {
+        threads.emplace_back([&, w]() {
+            for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+                // Skipped jobs count as finished too, so progress still ends at jobs.size()
+                if (token && token->isCancelled()) {
+                    results[i].error = "cancelled";
+                } else {
+                    results[i] = compressOne(jobs[i], arenas[w], token);
+                }
+                results[i].worker = w;
+
+                int done = ++finished;
+                if (progress) {
+                    lock_guard<mutex> lock(progressMutex);
+                    progress(done, static_cast<int>(jobs.size()));
+                }
+            }
+        });
+    }
+
+    for (thread& t : threads) {
+        t.join();
+    }
+    return results;
+}
+
+size_t BatchCompressor::bytesReserved() const {
+    size_t bytes = 0;
+    for (const BuildArena& arena : arenas) {
+        bytes += arena.bytesReserved();
+    }
+    return bytes;
+}
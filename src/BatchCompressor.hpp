@@ -0,0 +1,66 @@
+#ifndef BATCH_COMPRESSOR_HPP
+#define BATCH_COMPRESSOR_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <functional>
+#include "Quadtree.hpp"
+#include "BuildArena.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Options applied to every image of a batch
+struct BatchSettings {
+    ErrorMethod method = ErrorMethod::VARIANCE;
+    double threshold = 10.0;
+    int minBlockSize = 4;
+    double targetCompressionPct = 0.0;
+    BuildStrategy strategy = BuildStrategy::TOP_DOWN;
+    int paletteSize = 0;
+    bool lossless = false;
+};
+
+struct BatchJob {
+    string inputPath;
+    string outputPath;      // .qtc writes the container, any other extension the reconstruction
+};
+
+struct BatchResult {
+    bool ok = false;
+    string error;
+    Size size;
+    int leaves = 0;
+    double psnr = 0.0;      // From the leaf errors, 0 when the build stopped early
+    double milliseconds = 0.0;
+    int worker = -1;
+};
+
+// (finished, total), called from the worker that finished or skipped an image, one call at
+// a time; jobs skipped after cancellation are counted, so the last call has finished == total
+typedef function<void(int, int)> BatchProgress;
+
+// Compresses many images on a fixed number of workers, one image per worker at a time.
+// Each worker owns a BuildArena that lives as long as the compressor: input bytes, decoded
+// pixels, tree nodes, integral tables, histograms and the reconstruction grow to the largest
+// image seen and are reused, so a warmed-up worker does not allocate them again.
+class BatchCompressor {
+private:
+    BatchSettings settings;
+    vector<BuildArena> arenas;
+
+    BatchResult compressOne(const BatchJob& job, BuildArena& arena, const CancellationToken* token);
+
+public:
+    explicit BatchCompressor(const BatchSettings& settings, int workers = 0);  // 0 = one per hardware thread
+
+    // Blocks until every job ran or the token was cancelled; results are in job order
+    vector<BatchResult> run(const vector<BatchJob>& jobs, const CancellationToken* token = nullptr,
+                            BatchProgress progress = nullptr);
+
+    int workerCount() const { return static_cast<int>(arenas.size()); }
+    size_t bytesReserved() const;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "Bintree.hpp"
+#include "ImportanceMap.hpp"
+
+void Bintree::clear() {
+    nodes.clear();
+    imageSize = Size();
+    sumIntegral.release();
+    squareIntegral.release();
+    for (int c = 0; c < 3; c++) leafSse[c] = 0;
+    leafPixels = 0;
+    leafCount = 0;
+    depth = 0;
+}
+
+void Bintree::childRects(const Rect& parent, BintreeSplit split, Rect children[2]) {
+    if (split == BintreeSplit::HORIZONTAL) {
+        int halfHeight = std::max(1, parent.height / 2);
+        children[0] = Rect(parent.x, parent.y, parent.width, halfHeight);
+        children[1] = Rect(parent.x, parent.y + halfHeight, parent.width, parent.height - halfHeight);
+    } else {
+        int halfWidth = std::max(1, parent.width / 2);
+        children[0] = Rect(parent.x, parent.y, halfWidth, parent.height);
+        children[1] = Rect(parent.x + halfWidth, parent.y, parent.width - halfWidth, parent.height);
+    }
+}
+
+double Bintree::blockSse(const Rect& rect, double sse[3]) const {
+    double n = static_cast<double>(rect.width) * rect.height;
+    double total = 0;
+    for (int c = 0; c < 3; c++) {
+        double sum = ImportanceMap::rectSum(sumIntegral, rect, c);
+        double sumSq = ImportanceMap::rectSum(squareIntegral, rect, c);
+        sse[c] = n > 0 ? std::max(0.0, sumSq - sum * sum / n) : 0.0;
+        total += sse[c];
+    }
+    return total;
+}
+
+Vec3b Bintree::blockColor(const Rect& rect) const {
+    double n = static_cast<double>(rect.width) * rect.height;
+    if (n <= 0) return Vec3b(128, 128, 128);
+    // Truncated like BlockMoments::meanColor
+    return Vec3b(static_cast<uchar>(ImportanceMap::rectSum(sumIntegral, rect, 0) / n),
+                 static_cast<uchar>(ImportanceMap::rectSum(sumIntegral, rect, 1) / n),
+                 static_cast<uchar>(ImportanceMap::rectSum(sumIntegral, rect, 2) / n));
+}
+
+BintreeSplit Bintree::chooseSplit(const Rect& rect, int nodeDepth, double threshold, int minBlockSize, int maxDepth) const {
+    double sse[3];
+    double parentSse = blockSse(rect, sse);
+    if (nodeDepth >= maxDepth || parentSse / (3.0 * rect.width * rect.height) < threshold) {
+        return BintreeSplit::NONE;
+    }
+
+    BintreeSplit best = BintreeSplit::NONE;
+    double bestGain = 0;
+    const BintreeSplit options[2] = {BintreeSplit::VERTICAL, BintreeSplit::HORIZONTAL};
+
+    for (BintreeSplit split : options) {
+        int size = split == BintreeSplit::VERTICAL ? rect.width : rect.height;
+        if (size <= minBlockSize || size < 2) continue;
+
+        Rect children[2];
+        childRects(rect, split, children);
+        double gain = parentSse - blockSse(children[0], sse) - blockSse(children[1], sse);
+        if (gain > bestGain) {
+            bestGain = gain;
+            best = split;
+        }
+    }
+    return best;
+}
+
+void Bintree::build(const Mat& image, double threshold, int minBlockSize, int maxDepth) {
+    clear();
+    if (image.empty() || image.type() != CV_8UC3) return;
+
+    imageSize = image.size();
+    integral(image, sumIntegral, squareIntegral, CV_64F, CV_64F);
+
+    BintreeNode root = {0, 0, image.cols, image.rows, 0, -1, BintreeSplit::NONE, Vec3b(128, 128, 128)};
+    nodes.push_back(root);
+    vector<int> pending(1, 0);
+
+    while (!pending.empty()) {
+        int index = pending.back();
+        pending.pop_back();
+
+        BintreeNode& node = nodes[index];
+        Rect rect(node.x, node.y, node.width, node.height);
+        node.avgColor = blockColor(rect);
+        depth = std::max(depth, node.depth + 1);
+
+        BintreeSplit split = chooseSplit(rect, node.depth, threshold, minBlockSize, maxDepth);
+        if (split == BintreeSplit::NONE) {
+            double sse[3];
+            blockSse(rect, sse);
+            for (int c = 0; c < 3; c++) {
+                // Error against the truncated color, as BlockMoments::sseAgainst
+                double offset = ImportanceMap::rectSum(sumIntegral, rect, c) / rect.area() - node.avgColor[c];
+                leafSse[c] += sse[c] + rect.area() * offset * offset;
+            }
+            leafPixels += rect.area();
+            leafCount++;
+            continue;
+        }
+
+        Rect children[2];
+        childRects(rect, split, children);
+        int childDepth = node.depth + 1;
+        int firstChild = static_cast<int>(nodes.size());
+        node.split = split;
+        node.firstChild = firstChild;
+
+        // node is not used past this point: push_back may move it
+        for (int i = 0; i < 2; i++) {
+            BintreeNode child = {children[i].x, children[i].y, children[i].width, children[i].height,
+                                 childDepth, -1, BintreeSplit::NONE, Vec3b(128, 128, 128)};
+            nodes.push_back(child);
+        }
+        pending.push_back(firstChild + 1);
+        pending.push_back(firstChild);
+    }
+
+    sumIntegral.release();
+    squareIntegral.release();
+}
+
+void Bintree::reconstruct(Mat& image) const {
+    if (image.size() != imageSize || image.type() != CV_8UC3) {
+        image = Mat(imageSize, CV_8UC3, Scalar(128, 128, 128));
+    }
+
+    const Rect bounds(0, 0, image.cols, image.rows);
+    for (const BintreeNode& node : nodes) {
+        if (node.firstChild >= 0) continue;
+        Rect area = Rect(node.x, node.y, node.width, node.height) & bounds;
+        if (area.width > 0 && area.height > 0) {
+            image(area).setTo(Scalar(node.avgColor[0], node.avgColor[1], node.avgColor[2]));
+        }
+    }
+}
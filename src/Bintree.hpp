@@ -0,0 +1,68 @@
+#ifndef BINTREE_HPP
+#define BINTREE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <cstdint>
+
+using namespace cv;
+using namespace std;
+
+// Cut direction of a bintree node. HORIZONTAL cuts along a horizontal line (top and bottom
+// child), VERTICAL along a vertical one (left and right child). The cut is always at the
+// middle, max(1, size / 2), so the geometry follows from the image size and the cut bits.
+enum class BintreeSplit : uint8_t {
+    NONE = 0,
+    HORIZONTAL = 1,
+    VERTICAL = 2
+};
+
+struct BintreeNode {
+    int x, y, width, height;
+    int depth;
+    int firstChild;         // Index of the first of two adjacent children, -1 for a leaf
+    BintreeSplit split;
+    Vec3b avgColor;
+};
+
+// KD/bintree over the image: every node is cut in two, horizontally or vertically, or not
+// at all, whichever removes the most squared error. Errors and colors come from integral
+// images, so each node costs O(1) and no pixel is read after the integrals are built.
+// Banners and text lines need far fewer leaves than with 4-way splits.
+class Bintree {
+private:
+    vector<BintreeNode> nodes;      // Root first, children of a node are adjacent
+    Size imageSize;
+    Mat sumIntegral;                // Only kept while building
+    Mat squareIntegral;
+    double leafSse[3];
+    long long leafPixels;
+    size_t leafCount;
+    int depth;
+
+    double blockSse(const Rect& rect, double sse[3]) const;
+    Vec3b blockColor(const Rect& rect) const;
+    BintreeSplit chooseSplit(const Rect& rect, int nodeDepth, double threshold, int minBlockSize, int maxDepth) const;
+
+public:
+    Bintree() { clear(); }
+
+    // Splits while the block variance reaches threshold and a cut still lowers the error
+    void build(const Mat& image, double threshold, int minBlockSize, int maxDepth);
+    void clear();
+    bool empty() const { return nodes.empty(); }
+
+    void reconstruct(Mat& image) const;
+    static void childRects(const Rect& parent, BintreeSplit split, Rect children[2]);
+
+    const vector<BintreeNode>& getNodes() const { return nodes; }
+    void setLeafColor(size_t index, const Vec3b& color) { nodes[index].avgColor = color; }
+    size_t getNodeCount() const { return nodes.size(); }
+    size_t getLeafCount() const { return leafCount; }
+    int getDepth() const { return depth; }
+    Size getImageSize() const { return imageSize; }
+    double getSse(int channel) const { return leafSse[channel]; }
+    long long getCoveredPixels() const { return leafPixels; }
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef BLOCK_MOMENTS_HPP
+#define BLOCK_MOMENTS_HPP
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+// Per-channel pixel count, sum, sum of squares and range of a block. Variance, max pixel
+// difference and the SSIM error against the block average follow directly from these, and
+// the moments of a block are the merged moments of its parts.
+struct BlockMoments {
+    int count;
+    double sum[3];
+    double sumSq[3];
+    uchar minVal[3];
+    uchar maxVal[3];
+
+    BlockMoments() { clear(); }
+
+    void clear() {
+        count = 0;
+        for (int c = 0; c < 3; c++) {
+            sum[c] = 0;
+            sumSq[c] = 0;
+            minVal[c] = 255;
+            maxVal[c] = 0;
+        }
+    }
+
+    void add(const Vec3b& pixel) {
+        count++;
+        for (int c = 0; c < 3; c++) {
+            double v = pixel[c];
+            sum[c] += v;
+            sumSq[c] += v * v;
+            minVal[c] = std::min(minVal[c], pixel[c]);
+            maxVal[c] = std::max(maxVal[c], pixel[c]);
+        }
+    }
+
+    void merge(const BlockMoments& other) {
+        count += other.count;
+        for (int c = 0; c < 3; c++) {
+            sum[c] += other.sum[c];
+            sumSq[c] += other.sumSq[c];
+            minVal[c] = std::min(minVal[c], other.minVal[c]);
+            maxVal[c] = std::max(maxVal[c], other.maxVal[c]);
+        }
+    }
+
+    double mean(int c) const { return count > 0 ? sum[c] / count : 0.0; }
+
+    // Truncated like QuadtreeNode::calculateAverageColor
+    Vec3b meanColor() const {
+        if (count == 0) return Vec3b(128, 128, 128);
+        return Vec3b(static_cast<uchar>(sum[0] / count),
+                     static_cast<uchar>(sum[1] / count),
+                     static_cast<uchar>(sum[2] / count));
+    }
+
+    // Sum of squared deviations from the mean of one channel
+    double sse(int c) const {
+        if (count == 0) return 0.0;
+        return std::max(0.0, sumSq[c] - sum[c] * sum[c] / count);
+    }
+
+    // Sum of squared differences of one channel against a fixed value, e.g. the leaf color
+    double sseAgainst(int c, double value) const {
+        return std::max(0.0, sumSq[c] - 2.0 * value * sum[c] + count * value * value);
+    }
+
+    // Mean over the channels of the SSIM between the block and a uniform block of color
+    double ssimAgainst(const Vec3b& color) const {
+        if (count == 0) return 1.0;
+        const double C1 = 6.5025, C2 = 58.5225;     // (0.01 * 255)^2, (0.03 * 255)^2
+        double ssim = 0;
+        for (int c = 0; c < 3; c++) {
+            double a = color[c];
+            double mu = mean(c);
+            double sigmaSq = sse(c) / count;
+            ssim += (2 * mu * a + C1) * C2 / ((mu * mu + a * a + C1) * (sigmaSq + C2));
+        }
+        return ssim / 3.0;
+    }
+
+    // Same value as Quadtree::calculateVariance
+    double variance() const {
+        if (count <= 1) return 0.0;
+        return (sse(0) + sse(1) + sse(2)) / (3.0 * count);
+    }
+
+    // Same value as Quadtree::calculateMaxPixelDiff for blocks of more than 4 pixels
+    double maxPixelDiff() const {
+        if (count == 0) return 0.0;
+        return ((maxVal[0] - minVal[0]) + (maxVal[1] - minVal[1]) + (maxVal[2] - minVal[2])) / 3.0;
+    }
+
+    bool isUniform() const {
+        return count > 0 && minVal[0] == maxVal[0] && minVal[1] == maxVal[1] && minVal[2] == maxVal[2];
+    }
+
+    // One pass over block, accumulating the moments of the four quadrants split at
+    // (splitX, splitY). onRow(quadrants, rowsDone) runs after every row and may return
+    // false to stop the scan; the return value tells whether the whole block was read.
+    template <typename RowFn>
+    static bool gatherQuadrants(const Mat& block, int splitX, int splitY, BlockMoments quadrants[4], RowFn onRow) {
+        for (int q = 0; q < 4; q++) quadrants[q].clear();
+
+        int leftCols = std::min(std::max(0, splitX), block.cols);
+
+        for (int i = 0; i < block.rows; i++) {
+            const Vec3b* row = block.ptr<Vec3b>(i);
+            BlockMoments* half = &quadrants[i >= splitY ? 2 : 0];
+
+            for (int j = 0; j < leftCols; j++) half[0].add(row[j]);
+            for (int j = leftCols; j < block.cols; j++) half[1].add(row[j]);
+
+            if (!onRow(quadrants, i + 1)) return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,45 @@
+#include "BuildArena.hpp"
+
+QuadtreeNode* NodePool::allocate(int x, int y, int width, int height) {
+    QuadtreeNode* node;
+    if (freeList) {
+        node = freeList;
+        freeList = node->children[0];
+    } else {
+        if (used == capacity()) {
+            chunks.emplace_back(CHUNK_NODES);
+        }
+        node = &chunks[used / CHUNK_NODES][used % CHUNK_NODES];
+        used++;
+    }
+
+    *node = QuadtreeNode(x, y, width, height);
+    return node;
+}
+
+void NodePool::release(QuadtreeNode* node) {
+    node->children[0] = freeList;
+    freeList = node;
+}
+
+void NodePool::reset() {
+    used = 0;
+    freeList = nullptr;
+}
+
+Mat ScratchMat::view(Size size, int type) {
+    size_t bytes = static_cast<size_t>(size.width) * size.height * CV_ELEM_SIZE(type);
+    if (storage.size() < bytes) {
+        storage.resize(bytes);
+    }
+    return Mat(size, type, storage.data());
+}
+
+size_t BuildArena::bytesReserved() const {
+    size_t bytes = nodes.capacity() * sizeof(QuadtreeNode) + encoded.capacity() +
+                   histograms.capacity() * sizeof(int) + samples.capacity() * sizeof(Vec3b);
+    const ScratchMat* mats[] = {&decoded, &reduced, &solverImage, &gray, &gradX, &gradY, &gradient,
+                                &colorIntegral, &colorSqIntegral, &edgeIntegral, &reconstruction};
+    for (const ScratchMat* mat : mats) bytes += mat->capacity();
+    return bytes;
+}
@@ -0,0 +1,63 @@
+#ifndef BUILD_ARENA_HPP
+#define BUILD_ARENA_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "Quadtree.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Node storage owned by one thread. Nodes come out of fixed-size chunks that are never
+// returned to the heap; released nodes go on a free list, linked through children[0].
+// Not thread-safe: a Quadtree with an arena builds on the calling thread only.
+class NodePool {
+private:
+    static constexpr size_t CHUNK_NODES = 4096;
+
+    vector<vector<QuadtreeNode>> chunks;
+    size_t used;                // Nodes handed out from the chunks, in order
+    QuadtreeNode* freeList;
+
+public:
+    NodePool() : used(0), freeList(nullptr) {}
+
+    QuadtreeNode* allocate(int x, int y, int width, int height);
+    void release(QuadtreeNode* node);
+    // Every node back at once, the chunks stay for the next image
+    void reset();
+
+    size_t capacity() const { return chunks.size() * CHUNK_NODES; }
+};
+
+// Backing store for one Mat that only grows. view() hands out a header over it, so images
+// of any size up to the largest seen so far need no new allocation. A view is invalid once
+// view() is called again with a larger size.
+class ScratchMat {
+private:
+    vector<uchar> storage;
+
+public:
+    Mat view(Size size, int type);
+    size_t capacity() const { return storage.size(); }
+};
+
+// Scratch memory one batch worker keeps across images. Everything grows to its high-water
+// mark and is reused afterwards; reset() between images only rewinds the node pool.
+struct BuildArena {
+    NodePool nodes;
+    vector<uchar> encoded;          // Input file as read from disk
+    ScratchMat decoded;             // Input pixels, shared by the tree instead of a clone
+    ScratchMat reduced;             // Half-size copy for the threshold search
+    ScratchMat solverImage;         // The search's trial image when it is halved again
+    ScratchMat gray, gradX, gradY, gradient;
+    ScratchMat colorIntegral, colorSqIntegral, edgeIntegral;
+    ScratchMat reconstruction;
+    vector<int> histograms;         // Bottom-up merge slots, see MergeScratch
+    vector<Vec3b> samples;          // Sampled estimation of very large blocks
+
+    void reset() { nodes.reset(); }
+    size_t bytesReserved() const;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "CompactQuadtree.hpp"
+#include "Quadtree.hpp"
+
+void CompactQuadtree::clear() {
+    internalBits.clear();
+    rankDirectory.clear();
+    leafColors.clear();
+    rootWidth = rootHeight = 0;
+    nodeCount = leafCount = 0;
+    depth = 0;
+}
+
+bool CompactQuadtree::build(const QuadtreeNode* root) {
+    clear();
+    if (!root || root->x != 0 || root->y != 0 || !canStore(Size(root->width, root->height))) {
+        return false;
+    }
+
+    vector<const QuadtreeNode*> level(1, root);
+    vector<const QuadtreeNode*> next;
+    vector<Rect> rects(1, Rect(0, 0, root->width, root->height));
+    vector<Rect> nextRects;
+    size_t index = 0;
+    uint32_t internalSoFar = 0;
+
+    while (!level.empty()) {
+        depth++;
+        next.clear();
+        nextRects.clear();
+
+        for (size_t k = 0; k < level.size(); k++) {
+            const QuadtreeNode* node = level[k];
+            const Rect& rect = rects[k];
+
+            // Geometry is not stored, so it has to match what the halving rule implies
+            if (node->x != rect.x || node->y != rect.y || node->width != rect.width || node->height != rect.height) {
+                clear();
+                return false;
+            }
+
+            if ((index & 63) == 0) {
+                internalBits.push_back(0);
+                rankDirectory.push_back(internalSoFar);
+            }
+
+            if (node->isLeaf) {
+                leafColors.push_back(node->avgColor[0]);
+                leafColors.push_back(node->avgColor[1]);
+                leafColors.push_back(node->avgColor[2]);
+                leafCount++;
+            } else {
+                Rect children[4];
+                childRects(rect, children);
+                for (int i = 0; i < 4; i++) {
+                    if (!node->children[i]) {
+                        clear();
+                        return false;
+                    }
+                    next.push_back(node->children[i]);
+                    nextRects.push_back(children[i]);
+                }
+
+                internalBits.back() |= 1ULL << (index & 63);
+                internalSoFar++;
+            }
+            index++;
+        }
+
+        level.swap(next);
+        rects.swap(nextRects);
+    }
+
+    rootWidth = static_cast<uint16_t>(root->width);
+    rootHeight = static_cast<uint16_t>(root->height);
+    nodeCount = index;
+    internalBits.shrink_to_fit();
+    rankDirectory.shrink_to_fit();
+    leafColors.shrink_to_fit();
+    return true;
+}
+
+void CompactQuadtree::reconstruct(Mat& image) const {
+    Rect bounds(0, 0, image.cols, image.rows);
+
+    forEachLeaf([&image, &bounds](const Rect& rect, const Vec3b& color) {
+        Rect region = rect & bounds;
+        if (region.width <= 0 || region.height <= 0) return;
+
+        rectangle(image, region, Scalar(color[0], color[1], color[2]), FILLED);
+    });
+}
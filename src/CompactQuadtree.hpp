@@ -0,0 +1,107 @@
+#ifndef COMPACT_QUADTREE_HPP
+#define COMPACT_QUADTREE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <cstdint>
+
+using namespace cv;
+using namespace std;
+
+class QuadtreeNode;
+
+// Pointer-free quadtree. Nodes are numbered in breadth-first order and only two arrays
+// are stored: one "has children" bit per node and one BGR triple per leaf. Because every
+// internal node has exactly four children, the children of node i start at
+// 1 + 4 * (internal nodes before i), and the geometry of a node follows from its parent
+// by the same halving rule used when the tree was built. About 2.5 bytes per node.
+class CompactQuadtree {
+private:
+    uint16_t rootWidth, rootHeight;
+    vector<uint64_t> internalBits;
+    vector<uint32_t> rankDirectory;   // Internal nodes before each 64-bit word
+    vector<uint8_t> leafColors;       // Leaves in breadth-first order
+    size_t nodeCount;
+    size_t leafCount;
+    int depth;
+
+public:
+    CompactQuadtree() : rootWidth(0), rootHeight(0), nodeCount(0), leafCount(0), depth(0) {}
+
+    static bool canStore(Size imageSize) {
+        return imageSize.width > 0 && imageSize.height > 0 &&
+               imageSize.width <= 0xFFFF && imageSize.height <= 0xFFFF;
+    }
+
+    // Returns false (and stays empty) if the tree does not follow the implied geometry
+    bool build(const QuadtreeNode* root);
+    void clear();
+    bool empty() const { return nodeCount == 0; }
+
+    size_t rankInternal(size_t i) const {
+        uint64_t word = internalBits[i >> 6];
+        uint64_t mask = (i & 63) ? (~0ULL >> (64 - (i & 63))) : 0ULL;
+        return rankDirectory[i >> 6] + popcount64(word & mask);
+    }
+    bool isLeaf(size_t i) const { return ((internalBits[i >> 6] >> (i & 63)) & 1ULL) == 0; }
+    size_t firstChild(size_t i) const { return 1 + 4 * rankInternal(i); }
+    Vec3b leafColor(size_t i) const {
+        const uint8_t* p = &leafColors[3 * (i - rankInternal(i))];
+        return Vec3b(p[0], p[1], p[2]);
+    }
+
+    static void childRects(const Rect& parent, Rect children[4]) {
+        int halfWidth = std::max(1, parent.width / 2);
+        int halfHeight = std::max(1, parent.height / 2);
+        children[0] = Rect(parent.x, parent.y, halfWidth, halfHeight);
+        children[1] = Rect(parent.x + halfWidth, parent.y, parent.width - halfWidth, halfHeight);
+        children[2] = Rect(parent.x, parent.y + halfHeight, halfWidth, parent.height - halfHeight);
+        children[3] = Rect(parent.x + halfWidth, parent.y + halfHeight, parent.width - halfWidth, parent.height - halfHeight);
+    }
+
+    // Level-order walk over the leaves; reads both arrays strictly front to back
+    template <typename LeafFn>
+    void forEachLeaf(LeafFn onLeaf) const {
+        if (nodeCount == 0) return;
+
+        vector<Rect> level(1, Rect(0, 0, rootWidth, rootHeight));
+        vector<Rect> next;
+        size_t index = 0;
+        size_t leafIndex = 0;
+
+        while (!level.empty()) {
+            next.clear();
+            for (const Rect& rect : level) {
+                if (isLeaf(index)) {
+                    const uint8_t* p = &leafColors[3 * leafIndex++];
+                    onLeaf(rect, Vec3b(p[0], p[1], p[2]));
+                } else {
+                    Rect children[4];
+                    childRects(rect, children);
+                    next.insert(next.end(), children, children + 4);
+                }
+                index++;
+            }
+            level.swap(next);
+        }
+    }
+
+    void reconstruct(Mat& image) const;
+
+    size_t getNodeCount() const { return nodeCount; }
+    size_t getLeafCount() const { return leafCount; }
+    int getDepth() const { return depth; }
+    size_t memoryBytes() const {
+        return internalBits.size() * sizeof(uint64_t) + rankDirectory.size() * sizeof(uint32_t) + leafColors.size();
+    }
+
+private:
+    static size_t popcount64(uint64_t x) {
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return static_cast<size_t>((x * 0x0101010101010101ULL) >> 56);
+    }
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include "ImageLoader.hpp"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cctype>
+
+static const int MAX_DIMENSION = 1 << 20;
+
+static uint32_t readBE16(const uchar* p) { return (uint32_t(p[0]) << 8) | p[1]; }
+static uint32_t readBE32(const uchar* p) { return (readBE16(p) << 16) | readBE16(p + 2); }
+static uint32_t readLE16(const uchar* p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8); }
+static uint32_t readLE32(const uchar* p) { return readLE16(p) | (readLE16(p + 2) << 16); }
+
+static bool readAt(ifstream& file, uint64_t offset, size_t count, uchar* buffer) {
+    file.clear();
+    file.seekg(static_cast<streamoff>(offset));
+    file.read(reinterpret_cast<char*>(buffer), count);
+    return static_cast<size_t>(file.gcount()) == count;
+}
+
+// Orientation tag (0x0112) of IFD0 in an APP1 "Exif" payload; 1 (as stored) when absent
+static int readExifOrientation(const vector<uchar>& app1) {
+    const size_t n = app1.size();
+    if (n < 14 || memcmp(app1.data(), "Exif\0\0", 6) != 0) return 1;
+    const uchar* tiff = app1.data() + 6;
+    const size_t tiffSize = n - 6;
+
+    bool little = tiff[0] == 'I';
+    if (memcmp(tiff, "II*\0", 4) != 0 && memcmp(tiff, "MM\0*", 4) != 0) return 1;
+    auto u16 = [little](const uchar* p) { return little ? readLE16(p) : readBE16(p); };
+    auto u32 = [little](const uchar* p) { return little ? readLE32(p) : readBE32(p); };
+
+    uint64_t ifd = u32(tiff + 4);
+    if (ifd + 2 > tiffSize) return 1;
+    uint32_t entries = u16(tiff + ifd);
+    for (uint32_t i = 0; i < entries && ifd + 2 + 12 * uint64_t(i + 1) <= tiffSize; i++) {
+        const uchar* entry = tiff + ifd + 2 + 12 * i;
+        if (u16(entry) == 0x0112) {
+            uint32_t value = u16(entry + 8);
+            return value >= 1 && value <= 8 ? static_cast<int>(value) : 1;
+        }
+    }
+    return 1;
+}
+
+// Markers up to the first SOF; segments are skipped by their length, pixel data is never read.
+// imread applies the EXIF orientation, so orientations 5-8 (a quarter turn) swap the SOF size.
+static bool probeJpeg(ifstream& file, Size& size) {
+    uint64_t offset = 2;
+    int orientation = 1;
+    uchar marker[4];
+    while (readAt(file, offset, 2, marker)) {
+        if (marker[0] != 0xFF) return false;
+        if (marker[1] == 0xFF) {            // Fill byte
+            offset++;
+            continue;
+        }
+        offset += 2;
+
+        uchar type = marker[1];
+        if (type == 0x01 || (type >= 0xD0 && type <= 0xD7)) continue;   // No length
+        if (type == 0xD9 || type == 0xDA) return false;                 // EOI/SOS before any SOF
+
+        if (!readAt(file, offset, 2, marker)) return false;
+        uint32_t length = readBE16(marker);
+        if (length < 2) return false;
+
+        bool isSof = type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC;
+        if (isSof) {
+            uchar sof[5];
+            if (length < 7 || !readAt(file, offset + 2, 5, sof)) return false;
+            size = Size(static_cast<int>(readBE16(sof + 3)), static_cast<int>(readBE16(sof + 1)));
+            if (orientation >= 5) size = Size(size.height, size.width);
+            return true;
+        }
+        if (type == 0xE1 && orientation == 1 && length > 2) {
+            vector<uchar> app1(length - 2);
+            if (!readAt(file, offset + 2, app1.size(), app1.data())) return false;
+            orientation = readExifOrientation(app1);
+        }
+        offset += length;
+    }
+    return false;
+}
+
+static bool probeTiff(ifstream& file, const uchar* header, Size& size) {
+    bool little = header[0] == 'I';
+    auto u16 = [little](const uchar* p) { return little ? readLE16(p) : readBE16(p); };
+    auto u32 = [little](const uchar* p) { return little ? readLE32(p) : readBE32(p); };
+
+    uint32_t ifd = u32(header + 4);
+    uchar count[2];
+    if (!readAt(file, ifd, 2, count)) return false;
+
+    int width = 0, height = 0;
+    uint32_t entries = u16(count);
+    for (uint32_t i = 0; i < entries && i < 512; i++) {
+        uchar entry[12];
+        if (!readAt(file, ifd + 2 + 12 * static_cast<uint64_t>(i), 12, entry)) return false;
+
+        uint32_t tag = u16(entry);
+        uint32_t type = u16(entry + 2);
+        uint32_t value = type == 3 ? u16(entry + 8) : u32(entry + 8);     // SHORT or LONG
+        if (tag == 256) width = static_cast<int>(value);
+        if (tag == 257) height = static_cast<int>(value);
+    }
+
+    size = Size(width, height);
+    return true;
+}
+
+static bool readPnmNumber(const vector<uchar>& bytes, size_t& i, int& value) {
+    while (i < bytes.size()) {
+        if (bytes[i] == '#') {
+            while (i < bytes.size() && bytes[i] != '\n') i++;
+        } else if (isspace(bytes[i])) {
+            i++;
+        } else {
+            break;
+        }
+    }
+    if (i >= bytes.size() || !isdigit(bytes[i])) return false;
+
+    long long number = 0;
+    while (i < bytes.size() && isdigit(bytes[i]) && number <= MAX_DIMENSION) {
+        number = number * 10 + (bytes[i++] - '0');
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+bool probeImage(const string& path, ImageProbe& probe, string& errorMessage) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        errorMessage = "Tidak dapat membuka file: " + path;
+        return false;
+    }
+
+    vector<uchar> header(512, 0);
+    file.read(reinterpret_cast<char*>(header.data()), header.size());
+    header.resize(static_cast<size_t>(file.gcount()));
+    const uchar* h = header.data();
+    const size_t n = header.size();
+
+    bool parsed = false;
+    probe = ImageProbe();
+
+    if (n >= 24 && memcmp(h, "\x89PNG\r\n\x1a\n", 8) == 0 && memcmp(h + 12, "IHDR", 4) == 0) {
+        probe.format = "png";
+        probe.size = Size(static_cast<int>(readBE32(h + 16)), static_cast<int>(readBE32(h + 20)));
+        parsed = true;
+    } else if (n >= 3 && h[0] == 0xFF && h[1] == 0xD8 && h[2] == 0xFF) {
+        probe.format = "jpeg";
+        parsed = probeJpeg(file, probe.size);
+    } else if (n >= 26 && h[0] == 'B' && h[1] == 'M') {
+        probe.format = "bmp";
+        int width = static_cast<int>(readLE32(h + 18));
+        int height = static_cast<int>(readLE32(h + 22));
+        probe.size = Size(width, height < 0 ? -height : height);     // Negative = top-down rows
+        parsed = true;
+    } else if (n >= 30 && memcmp(h, "RIFF", 4) == 0 && memcmp(h + 8, "WEBP", 4) == 0) {
+        probe.format = "webp";
+        if (memcmp(h + 12, "VP8 ", 4) == 0) {
+            probe.size = Size(static_cast<int>(readLE16(h + 26) & 0x3FFF), static_cast<int>(readLE16(h + 28) & 0x3FFF));
+            parsed = true;
+        } else if (memcmp(h + 12, "VP8L", 4) == 0 && h[20] == 0x2F) {
+            uint32_t bits = readLE32(h + 21);
+            probe.size = Size(static_cast<int>((bits & 0x3FFF) + 1), static_cast<int>(((bits >> 14) & 0x3FFF) + 1));
+            parsed = true;
+        } else if (memcmp(h + 12, "VP8X", 4) == 0) {
+            probe.size = Size(static_cast<int>((h[24] | (h[25] << 8) | (h[26] << 16)) + 1),
+                              static_cast<int>((h[27] | (h[28] << 8) | (h[29] << 16)) + 1));
+            parsed = true;
+        }
+    } else if (n >= 2 && h[0] == 'P' && h[1] >= '1' && h[1] <= '6') {
+        probe.format = "pnm";
+        size_t i = 2;
+        int width = 0, height = 0;
+        parsed = readPnmNumber(header, i, width) && readPnmNumber(header, i, height);
+        probe.size = Size(width, height);
+    } else if (n >= 8 && (memcmp(h, "II*\0", 4) == 0 || memcmp(h, "MM\0*", 4) == 0)) {
+        probe.format = "tiff";
+        parsed = probeTiff(file, h, probe.size);
+    }
+
+    if (probe.format.empty()) {
+        errorMessage = "Bukan file gambar yang dikenali (header tidak cocok dengan JPG, PNG, WEBP, BMP, TIFF, atau PPM/PGM).";
+        return false;
+    }
+    if (!parsed || probe.size.width <= 0 || probe.size.height <= 0 ||
+        probe.size.width > MAX_DIMENSION || probe.size.height > MAX_DIMENSION) {
+        errorMessage = "Header gambar rusak atau ukuran gambar tidak valid.";
+        return false;
+    }
+    return true;
+}
+
+Size sourceGeometry(const ImageProbe& probe, const Mat& image, int scale) {
+    auto covers = [&image, scale](const Size& size) {
+        return (size.width + scale - 1) / scale == image.cols && (size.height + scale - 1) / scale == image.rows;
+    };
+    if (covers(probe.size)) return probe.size;
+
+    Size turned(probe.size.height, probe.size.width);
+    if (covers(turned)) return turned;
+    return Size(image.cols * scale, image.rows * scale);
+}
+
+Mat loadImage(const string& path, const ImageProbe& probe, int scale, int* appliedScale) {
+    int flags = IMREAD_COLOR;
+    int applied = 1;
+    if (probe.isJpeg()) {
+        if (scale >= 8) {
+            flags = IMREAD_REDUCED_COLOR_8;
+            applied = 8;
+        } else if (scale >= 4) {
+            flags = IMREAD_REDUCED_COLOR_4;
+            applied = 4;
+        } else if (scale >= 2) {
+            flags = IMREAD_REDUCED_COLOR_2;
+            applied = 2;
+        }
+    }
+
+    Mat image = imread(path, flags);
+    if (image.empty()) {
+        if (appliedScale) *appliedScale = 1;
+        return image;
+    }
+
+    // Box pyramid for the rest: each level averages 2x2 blocks, odd edges keep their half block
+    while (applied * 2 <= scale && std::min(image.cols, image.rows) > 1) {
+        Mat half;
+        resize(image, half, Size((image.cols + 1) / 2, (image.rows + 1) / 2), 0, 0, INTER_AREA);
+        image = half;
+        applied *= 2;
+    }
+
+    if (appliedScale) *appliedScale = applied;
+    return image;
+}
+
+double scaledTargetCompression(double targetCompressionPct, int scale) {
+    return 100.0 - (100.0 - targetCompressionPct) * scale * scale;
+}
+
+int chooseDecodeScale(const ImageProbe& probe, double targetCompressionPct) {
+    if (targetCompressionPct <= 0.0) return 1;
+
+    int shortSide = std::min(probe.size.width, probe.size.height);
+    for (int scale = 16; scale >= 2; scale /= 2) {
+        if (shortSide / scale >= 256 && scaledTargetCompression(targetCompressionPct, scale) >= 75.0) {
+            return scale;
+        }
+    }
+    return 1;
+}
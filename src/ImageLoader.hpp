@@ -0,0 +1,41 @@
+#ifndef IMAGE_LOADER_HPP
+#define IMAGE_LOADER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+// What the file header says, read without decoding any pixel data
+struct ImageProbe {
+    Size size;
+    string format;      // "jpeg", "png", "bmp", "webp", "pnm" or "tiff"
+    bool isJpeg() const { return format == "jpeg"; }
+};
+
+// Checks magic bytes and reads the dimensions from the header (JPEG: first SOF marker, turned
+// by the EXIF orientation as imread does; TIFF: first IFD). Fails on unknown formats,
+// truncated headers and zero or absurd sizes.
+bool probeImage(const string& path, ImageProbe& probe, string& errorMessage);
+
+// Single decode to 8-bit BGR at 1/scale (scale a power of two), ceil(width / scale) x
+// ceil(height / scale). JPEG takes up to 1/8 straight from the DCT coefficients
+// (IMREAD_REDUCED_COLOR_*); whatever remains, and every other format, goes down a 2x2 box
+// pyramid. appliedScale receives the scale of the returned image.
+Mat loadImage(const string& path, const ImageProbe& probe, int scale = 1, int* appliedScale = nullptr);
+
+// Full-size geometry of image, decoded at 1/scale: the probed size when image covers it
+// (ceil(size / scale) == image.size()), else the probed size turned a quarter (an orientation
+// the probe did not see), else image.size() * scale
+Size sourceGeometry(const ImageProbe& probe, const Mat& image, int scale);
+
+// Leaf-ratio target at 1/scale for the same leaf count as target at full size
+double scaledTargetCompression(double targetCompressionPct, int scale);
+
+// Largest power-of-two scale (up to 16) whose scaled target stays in the adaptive range
+// (>= 75%, i.e. leaves of 4+ pixels on average) with at least 256 pixels on the short
+// side; 1 when full resolution is needed or no target is set.
+int chooseDecodeScale(const ImageProbe& probe, double targetCompressionPct);
+
+#endif
@@ -0,0 +1,102 @@
+#include "ImportanceMap.hpp"
+
+void ImportanceMap::clear() {
+    weightIntegral.release();
+    momentIntegral.release();
+    squareIntegral.release();
+}
+
+void ImportanceMap::build(const Mat& weights, Size imageSize, const Mat& image) {
+    clear();
+    if (weights.empty() || imageSize.width <= 0 || imageSize.height <= 0) return;
+
+    Mat w;
+    weights.convertTo(w, CV_64F);
+    if (w.channels() > 1) {
+        Mat gray;
+        extractChannel(w, gray, 0);
+        w = gray;
+    }
+    if (w.size() != imageSize) {
+        Mat resized;
+        resize(w, resized, imageSize, 0, 0, INTER_LINEAR);
+        w = resized;
+    }
+
+    // Tanpa bobot negatif, rata-rata 1 supaya threshold tetap bermakna sama
+    double total = 0;
+    for (int i = 0; i < w.rows; i++) {
+        double* row = w.ptr<double>(i);
+        for (int j = 0; j < w.cols; j++) {
+            row[j] = std::max(0.0, row[j]);
+            total += row[j];
+        }
+    }
+    double scale = total > 0 ? static_cast<double>(w.rows) * w.cols / total : 0.0;
+    if (scale > 0) {
+        w.convertTo(w, CV_64F, scale);
+    } else {
+        w = Mat(imageSize, CV_64F, Scalar(1.0));
+    }
+
+    integral(w, weightIntegral, CV_64F);
+
+    if (!image.empty() && image.size() == imageSize && image.type() == CV_8UC3) {
+        Mat wx(imageSize, CV_64FC3), wxx(imageSize, CV_64FC3);
+        for (int i = 0; i < image.rows; i++) {
+            const Vec3b* src = image.ptr<Vec3b>(i);
+            const double* weight = w.ptr<double>(i);
+            Vec3d* first = wx.ptr<Vec3d>(i);
+            Vec3d* second = wxx.ptr<Vec3d>(i);
+            for (int j = 0; j < image.cols; j++) {
+                for (int c = 0; c < 3; c++) {
+                    double v = src[j][c];
+                    first[j][c] = weight[j] * v;
+                    second[j][c] = weight[j] * v * v;
+                }
+            }
+        }
+        integral(wx, momentIntegral, CV_64F);
+        integral(wxx, squareIntegral, CV_64F);
+    }
+}
+
+double ImportanceMap::rectSum(const Mat& integralImage, const Rect& rect, int channel) {
+    int cn = integralImage.channels();
+    const double* top = integralImage.ptr<double>(rect.y);
+    const double* bottom = integralImage.ptr<double>(rect.y + rect.height);
+    int left = rect.x * cn + channel;
+    int right = (rect.x + rect.width) * cn + channel;
+    return bottom[right] - bottom[left] - top[right] + top[left];
+}
+
+double ImportanceMap::meanWeight(const Rect& rect) const {
+    if (empty() || rect.width <= 0 || rect.height <= 0) return 1.0;
+    return rectSum(weightIntegral, rect) / (static_cast<double>(rect.width) * rect.height);
+}
+
+double ImportanceMap::weightedVariance(const Rect& rect) const {
+    if (!hasMoments() || rect.width <= 0 || rect.height <= 0) return 0.0;
+
+    double weightSum = rectSum(weightIntegral, rect);
+    if (weightSum <= 0) return 0.0;
+
+    double sse = 0;
+    for (int c = 0; c < 3; c++) {
+        double first = rectSum(momentIntegral, rect, c);
+        double second = rectSum(squareIntegral, rect, c);
+        sse += std::max(0.0, second - first * first / weightSum);
+    }
+    return sse / (3.0 * rect.width * rect.height);
+}
+
+Mat ImportanceMap::boxWeights(Size size, const vector<Rect>& boxes, double inside, double outside) {
+    Mat weights(size, CV_32F, Scalar(outside));
+    for (const Rect& box : boxes) {
+        Rect clipped = box & Rect(0, 0, size.width, size.height);
+        if (clipped.width > 0 && clipped.height > 0) {
+            weights(clipped).setTo(Scalar(inside));
+        }
+    }
+    return weights;
+}
@@ -0,0 +1,39 @@
+#ifndef IMPORTANCE_MAP_HPP
+#define IMPORTANCE_MAP_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// Per-pixel importance (saliency, face boxes, ...) folded into the split decision. The
+// weights are rescaled to mean 1 and kept as integral images, together with the weighted
+// first and second moments of the image, so the weighted error of any block is O(1):
+//   weighted variance = sum_c (Sw*x^2 - (Sw*x)^2 / Sw) / (3 * pixels)
+// which is the plain variance wherever the weight is 1.
+class ImportanceMap {
+private:
+    Mat weightIntegral;     // CV_64F, (rows+1) x (cols+1)
+    Mat momentIntegral;     // CV_64FC3 of w*x, empty without image
+    Mat squareIntegral;     // CV_64FC3 of w*x^2
+
+public:
+    // Sum over rect of one channel of a CV_64F integral image
+    static double rectSum(const Mat& integralImage, const Rect& rect, int channel = 0);
+
+    // weights: any single-channel map, resized to the image if needed. Negative values
+    // count as 0; an all-zero map means uniform weights.
+    void build(const Mat& weights, Size imageSize, const Mat& image = Mat());
+    void clear();
+    bool empty() const { return weightIntegral.empty(); }
+    bool hasMoments() const { return !momentIntegral.empty(); }
+
+    double meanWeight(const Rect& rect) const;
+    double weightedVariance(const Rect& rect) const;    // Needs hasMoments()
+
+    // Weight `inside` within the boxes and `outside` elsewhere, before rescaling
+    static Mat boxWeights(Size size, const vector<Rect>& boxes, double inside, double outside);
+};
+
+#endif
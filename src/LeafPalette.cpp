@@ -0,0 +1,192 @@
+#include "LeafPalette.hpp"
+#include <algorithm>
+
+namespace {
+
+struct WeightedColor {
+    Vec3b color;
+    double weight;
+};
+
+// Contiguous range of the entry array, split along its widest channel
+struct ColorBox {
+    int begin, end;
+    double weight;
+    int channel;
+    int range;
+};
+
+ColorBox describeBox(const vector<WeightedColor>& entries, int begin, int end) {
+    ColorBox box = {begin, end, 0.0, 0, 0};
+    int low[3] = {255, 255, 255}, high[3] = {0, 0, 0};
+    for (int i = begin; i < end; i++) {
+        box.weight += entries[i].weight;
+        for (int c = 0; c < 3; c++) {
+            low[c] = std::min<int>(low[c], entries[i].color[c]);
+            high[c] = std::max<int>(high[c], entries[i].color[c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        if (high[c] - low[c] > box.range) {
+            box.range = high[c] - low[c];
+            box.channel = c;
+        }
+    }
+    return box;
+}
+
+int squaredDistance(const Vec3b& a, const Vec3d& b) {
+    double d0 = a[0] - b[0], d1 = a[1] - b[1], d2 = a[2] - b[2];
+    return static_cast<int>(d0 * d0 + d1 * d1 + d2 * d2);
+}
+
+}
+
+void LeafPalette::index() {
+    lookup.clear();
+    for (int i = 0; i < static_cast<int>(colors.size()); i++) {
+        lookup.emplace(key(colors[i]), i);
+    }
+}
+
+void LeafPalette::setColors(const vector<Vec3b>& paletteColors) {
+    colors = paletteColors;
+    if (colors.size() > static_cast<size_t>(MAX_COLORS)) colors.resize(MAX_COLORS);
+    index();
+}
+
+void LeafPalette::clear() {
+    colors.clear();
+    lookup.clear();
+}
+
+int LeafPalette::nearest(const Vec3b& c) const {
+    auto hit = lookup.find(key(c));
+    if (hit != lookup.end()) return hit->second;
+
+    int best = 0;
+    int bestDistance = INT32_MAX;
+    for (int i = 0; i < static_cast<int>(colors.size()); i++) {
+        int d0 = c[0] - colors[i][0], d1 = c[1] - colors[i][1], d2 = c[2] - colors[i][2];
+        int distance = d0 * d0 + d1 * d1 + d2 * d2;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+    return best;
+}
+
+LeafPalette LeafPalette::build(const vector<Vec3b>& leafColors, const vector<double>& weights,
+                               int maxColors, int iterations) {
+    LeafPalette palette;
+    maxColors = std::max(1, std::min(maxColors, MAX_COLORS));
+    if (leafColors.empty()) return palette;
+
+    // Identical leaf colors become one weighted entry
+    unordered_map<uint32_t, size_t> slots;
+    vector<WeightedColor> entries;
+    for (size_t i = 0; i < leafColors.size(); i++) {
+        double weight = i < weights.size() ? weights[i] : 1.0;
+        auto inserted = slots.emplace(key(leafColors[i]), entries.size());
+        if (inserted.second) {
+            entries.push_back(WeightedColor{leafColors[i], weight});
+        } else {
+            entries[inserted.first->second].weight += weight;
+        }
+    }
+
+    if (static_cast<int>(entries.size()) <= maxColors) {
+        vector<Vec3b> exact;
+        for (const WeightedColor& entry : entries) exact.push_back(entry.color);
+        palette.setColors(exact);
+        return palette;
+    }
+
+    // Median cut: the heaviest box that still has a spread is cut at its weighted median
+    vector<ColorBox> boxes(1, describeBox(entries, 0, static_cast<int>(entries.size())));
+    while (static_cast<int>(boxes.size()) < maxColors) {
+        int pick = -1;
+        double score = 0;
+        for (int b = 0; b < static_cast<int>(boxes.size()); b++) {
+            double s = boxes[b].weight * boxes[b].range;
+            if (boxes[b].end - boxes[b].begin > 1 && s > score) {
+                score = s;
+                pick = b;
+            }
+        }
+        if (pick < 0) break;
+
+        ColorBox box = boxes[pick];
+        int channel = box.channel;
+        sort(entries.begin() + box.begin, entries.begin() + box.end,
+             [channel](const WeightedColor& a, const WeightedColor& b) { return a.color[channel] < b.color[channel]; });
+
+        int cut = box.begin + 1;
+        double running = entries[box.begin].weight;
+        while (cut < box.end - 1 && running + entries[cut].weight <= box.weight / 2) {
+            running += entries[cut].weight;
+            cut++;
+        }
+
+        boxes[pick] = describeBox(entries, box.begin, cut);
+        boxes.push_back(describeBox(entries, cut, box.end));
+    }
+
+    vector<Vec3d> centers(boxes.size(), Vec3d(0, 0, 0));
+    for (size_t b = 0; b < boxes.size(); b++) {
+        Vec3d sum(0, 0, 0);
+        for (int i = boxes[b].begin; i < boxes[b].end; i++) {
+            for (int c = 0; c < 3; c++) sum[c] += entries[i].color[c] * entries[i].weight;
+        }
+        for (int c = 0; c < 3; c++) centers[b][c] = boxes[b].weight > 0 ? sum[c] / boxes[b].weight : 0.0;
+    }
+
+    // k-means rounds: assignment in parallel stripes, each stripe with its own sums
+    const int k = static_cast<int>(centers.size());
+    const int stripes = std::max(1, std::min(static_cast<int>(entries.size()) / 4096 + 1, getNumThreads() * 4));
+    for (int round = 0; round < iterations; round++) {
+        vector<vector<Vec4d>> partial(stripes, vector<Vec4d>(k, Vec4d(0, 0, 0, 0)));
+
+        parallel_for_(Range(0, stripes), [&](const Range& range) {
+            for (int s = range.start; s < range.end; s++) {
+                size_t first = entries.size() * s / stripes;
+                size_t last = entries.size() * (s + 1) / stripes;
+                vector<Vec4d>& sums = partial[s];
+
+                for (size_t i = first; i < last; i++) {
+                    int best = 0;
+                    int bestDistance = INT32_MAX;
+                    for (int j = 0; j < k; j++) {
+                        int distance = squaredDistance(entries[i].color, centers[j]);
+                        if (distance < bestDistance) {
+                            bestDistance = distance;
+                            best = j;
+                        }
+                    }
+                    double w = entries[i].weight;
+                    for (int c = 0; c < 3; c++) sums[best][c] += entries[i].color[c] * w;
+                    sums[best][3] += w;
+                }
+            }
+        });
+
+        for (int j = 0; j < k; j++) {
+            Vec4d total(0, 0, 0, 0);
+            for (int s = 0; s < stripes; s++) {
+                for (int c = 0; c < 4; c++) total[c] += partial[s][j][c];
+            }
+            if (total[3] > 0) {
+                for (int c = 0; c < 3; c++) centers[j][c] = total[c] / total[3];
+            }
+        }
+    }
+
+    vector<Vec3b> result;
+    for (const Vec3d& center : centers) {
+        result.push_back(Vec3b(static_cast<uchar>(cvRound(center[0])), static_cast<uchar>(cvRound(center[1])),
+                               static_cast<uchar>(cvRound(center[2]))));
+    }
+    palette.setColors(result);
+    return palette;
+}
@@ -0,0 +1,41 @@
+#ifndef LEAF_PALETTE_HPP
+#define LEAF_PALETTE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace cv;
+using namespace std;
+
+// Palette for the leaf colors of a finished tree. Works on the leaves only (weighted by
+// their area), never on pixels: identical colors are folded first, a weighted median cut
+// gives the starting palette and a few k-means rounds, run in parallel, refine it.
+class LeafPalette {
+private:
+    vector<Vec3b> colors;
+    unordered_map<uint32_t, int> lookup;    // Exact palette colors to their index
+
+    static uint32_t key(const Vec3b& c) { return uint32_t(c[0]) | (uint32_t(c[1]) << 8) | (uint32_t(c[2]) << 16); }
+    void index();
+
+public:
+    static constexpr int MAX_COLORS = 65535;    // Indices are stored as uint16 at most
+
+    static LeafPalette build(const vector<Vec3b>& leafColors, const vector<double>& weights,
+                             int maxColors, int iterations = 4);
+    void setColors(const vector<Vec3b>& paletteColors);
+    void clear();
+
+    bool empty() const { return colors.empty(); }
+    int size() const { return static_cast<int>(colors.size()); }
+    const Vec3b& color(int i) const { return colors[i]; }
+    const vector<Vec3b>& getColors() const { return colors; }
+    int bytesPerIndex() const { return colors.size() <= 256 ? 1 : 2; }
+
+    // Exact hit through the lookup, otherwise the closest color in squared distance
+    int nearest(const Vec3b& c) const;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "NumaTopology.hpp"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace fs = std::filesystem;
+
+NumaTopology::NumaTopology() {
+#ifdef __linux__
+    // Node IDs may have gaps (hot-remove, some firmware), so the online list names them
+    const fs::path nodeRoot = "/sys/devices/system/node";
+    string onlineList;
+    ifstream online(nodeRoot / "online");
+    getline(online, onlineList);
+
+    for (int node : parseCpuList(onlineList)) {
+        ifstream file(nodeRoot / ("node" + to_string(node)) / "cpulist");
+        if (!file.is_open()) continue;
+
+        string list;
+        getline(file, list);
+        vector<int> cpus = parseCpuList(list);
+        if (!cpus.empty()) {
+            nodeCpus.push_back(cpus);
+        }
+    }
+#endif
+
+    if (nodeCpus.empty()) {
+        nodeCpus.push_back(vector<int>());
+    }
+}
+
+const NumaTopology& NumaTopology::get() {
+    static const NumaTopology topology;
+    return topology;
+}
+
+vector<int> NumaTopology::parseCpuList(const string& list) {
+    vector<int> cpus;
+    stringstream ss(list);
+    string range;
+
+    while (getline(ss, range, ',')) {
+        if (range.empty()) continue;
+
+        try {
+            size_t dash = range.find('-');
+            int first = stoi(range.substr(0, dash));
+            int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const exception&) {
+            return vector<int>();
+        }
+    }
+    return cpus;
+}
+
+bool NumaTopology::pinCurrentThread(int node) const {
+#ifdef __linux__
+    const vector<int>& cpus = cpusOf(node);
+    if (cpus.empty()) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
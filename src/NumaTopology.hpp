@@ -0,0 +1,30 @@
+#ifndef NUMA_TOPOLOGY_HPP
+#define NUMA_TOPOLOGY_HPP
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// CPUs of every online NUMA node (node/online, then nodeN/cpulist), read once from
+// /sys/devices/system/node. Hosts without that information (or other platforms) show up as
+// a single node with an empty CPU list.
+class NumaTopology {
+private:
+    vector<vector<int>> nodeCpus;
+
+    NumaTopology();
+
+public:
+    static const NumaTopology& get();
+    static vector<int> parseCpuList(const string& list);   // "0-3,8,10-11"
+
+    int nodeCount() const { return static_cast<int>(nodeCpus.size()); }
+    const vector<int>& cpusOf(int node) const { return nodeCpus[node % nodeCount()]; }
+
+    // Restricts the calling thread to the CPUs of node. Memory the thread touches first
+    // afterwards is then placed on that node by the kernel's first-touch policy.
+    bool pinCurrentThread(int node) const;
+};
+
+#endif
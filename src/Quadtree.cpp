@@ -1,5 +1,11 @@
 #include "Quadtree.hpp"
+#include "QuadtreeTraversal.hpp"
+#include "QuadtreeCodec.hpp"
+#include "NumaTopology.hpp"
+#include "QualityMetrics.hpp"
+#include "BuildArena.hpp"
 #include <cmath>
+#include <cstring>
 #include <map>
 #include <algorithm>
 #include <chrono>
@@ -7,6 +13,9 @@
 #include <iomanip>
 #include <sstream>
 #include <future>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
 #include <random>
 #include <fstream>
 
@@ -21,6 +30,7 @@ string getErrorMethodName(ErrorMethod method) {
         case ErrorMethod::MAX_PIXEL_DIFF: return "Max Pixel Difference";
         case ErrorMethod::ENTROPY: return "Entropy";
         case ErrorMethod::SSIM: return "SSIM";
+        case ErrorMethod::EDGE_AWARE: return "Edge-Aware Variance";
         default: return "Unknown";
     }
 }
@@ -72,53 +82,91 @@ void QuadtreeNode::calculateAverageColor(const Mat& image) {
 }
 
 Quadtree::Quadtree(const Mat& image, double threshold, int minBlockSize, 
-                   ErrorMethod method, double targetCompressionPct, bool visualizeGif)
+                   ErrorMethod method, double targetCompressionPct, bool visualizeGif,
+                   BuildArena* arena)
     : threshold(threshold), 
       minBlockSize(minBlockSize), 
       errorMethod(method), 
       targetCompressionPct(targetCompressionPct),
       visualizeGif(visualizeGif),
+      gifFrameRate(3),
       nodeCounter(0),
       timeoutFlag(false),
+      pixelsFinalized(0),
+      cancelToken(nullptr),
+      progressIntervalMs(100),
+      nextProgressReport(0),
       maxDepth(10),
       forceLowCompression(false),
-      useHybridCompression(false),
       targetNodeRatio(1.0),
-      centerMinBlockSize(2),
-      centerMaxDepth(10),
-      outerMinBlockSize(16),
-      outerMaxDepth(4) {
+      useBintree(false),
+      solverImportance(false),
+      useCompactStorage(false),
+      useSampledEstimation(false),
+      samplingMinPixels(512 * 512),
+      samplingCount(1024),
+      samplingConfidence(3.0),
+      samplingOffset(0.5, 0.5),
+      sampledSplits(0),
+      buildStrategy(BuildStrategy::TOP_DOWN),
+      numaAware(false),
+      targetPsnr(0.0),
+      targetSsim(0.0),
+      paletteSize(0),
+      lossless(false),
+      outputScale(1),
+      arena(arena) {
           
-    sourceImage = image.clone();
-    root = new QuadtreeNode(0, 0, image.cols, image.rows);
+    sourceImage = arena ? image : image.clone();
+    root = newNode(0, 0, image.cols, image.rows);
+    buildStats.reset();
+    refreshTotals();
     
     random_device rd;
     rng = mt19937(rd());
 }
 
+void Quadtree::setImportanceMap(const Mat& weights) {
+    solverImportance = false;
+    if (weights.empty()) {
+        importance.clear();
+        return;
+    }
+    importance.build(weights, sourceImage.size(), sourceImage);
+}
+
+void Quadtree::setSampledEstimation(bool enabled, int minBlockPixels, int samples, double confidence) {
+    useSampledEstimation = enabled;
+    samplingMinPixels = std::max(1, minBlockPixels);
+    samplingCount = std::max(16, samples);
+    samplingConfidence = std::max(0.0, confidence);
+}
+
 Quadtree::~Quadtree() {
     deleteTree(root);
 }
 
-void Quadtree::deleteTree(QuadtreeNode* node) {
-    if (!node) return;
-    for (int i = 0; i < 4; ++i) {
-        deleteTree(node->children[i]);
-    }
-    delete node;
+QuadtreeNode* Quadtree::newNode(int x, int y, int width, int height) {
+    if (arena) return arena->nodes.allocate(x, y, width, height);
+    return new QuadtreeNode(x, y, width, height);
 }
 
-Mat Quadtree::getSafeRoi(const Mat& image, int x, int y, int width, int height) {
-    int startX = max(0, x);
-    int startY = max(0, y);
-    int endX = min(x + width, image.cols);
-    int endY = min(y + height, image.rows);
-    
-    if (startX >= endX || startY >= endY) {
-        return Mat();
-    }
+void Quadtree::deleteTree(QuadtreeNode* node) {
+    class DeleteVisitor : public QuadtreeVisitor {
+    public:
+        NodePool* pool;
+        explicit DeleteVisitor(NodePool* pool) : pool(pool) {}
+        bool enterNode(QuadtreeNode*, int) override { return true; }
+        void leaveNode(QuadtreeNode* node, int) override {
+            if (pool) {
+                pool->release(node);
+            } else {
+                delete node;
+            }
+        }
+    } deleter(arena ? &arena->nodes : nullptr);
     
-    return image(Rect(startX, startY, endX - startX, endY - startY));
+    traverseQuadtree(node, deleter);
 }
 
 double Quadtree::calculateVariance(const Mat& block) {
@@ -341,17 +389,428 @@ double Quadtree::calculateError(const Mat& block, const Mat& avgBlock) {
             return calculateEntropy(block);
         case ErrorMethod::SSIM:
             if (avgBlock.empty()) {
-                Scalar meanColor = mean(block);
-                Mat uniformBlock(block.size(), block.type(), Scalar(meanColor[0], meanColor[1], meanColor[2]));
-                return calculateSSIM(block, uniformBlock);
+                return uniformBlockSSIM(block);
             } else {
                 return calculateSSIM(block, avgBlock);
             }
+        case ErrorMethod::EDGE_AWARE:
+            // Blok kecil: tepi mengisi sebagian besar blok, variance sudah menangkapnya
+            return calculateVariance(block);
         default:
             return calculateVariance(block);
     }
 }
 
+double Quadtree::uniformBlockSSIM(const Mat& block) {
+    if (block.empty()) return 0.0;
+    if (block.rows < 4 || block.cols < 4) {
+        return calculateVariance(block) / 1000.0;
+    }
+    
+    // The uniform block is the mean rounded to 8 bits, as a Mat filled from a Scalar would be.
+    // Its own deviation and the covariance vanish, so only the block's moments are needed.
+    BlockMoments moments;
+    for (int i = 0; i < block.rows; i++) {
+        const Vec3b* row = block.ptr<Vec3b>(i);
+        for (int j = 0; j < block.cols; j++) moments.add(row[j]);
+    }
+    
+    const double C1 = pow(0.01 * 255.0, 2);
+    const double C2 = pow(0.03 * 255.0, 2);
+    double values[3];
+    for (int c = 0; c < 3; c++) {
+        double mu1 = moments.mean(c);
+        double mu2 = saturate_cast<uchar>(mu1);
+        double sigma1_sq = moments.sse(c) / (moments.count - 1);
+        
+        double numerator = (2 * mu1 * mu2 + C1) * C2;
+        double denominator = (mu1 * mu1 + mu2 * mu2 + C1) * (sigma1_sq + C2);
+        double ssim = denominator > 0.001 ? numerator / denominator : 0.99;
+        values[c] = std::max(0.0, std::min(1.0, 1.0 - ssim));
+    }
+    
+    return (0.299 * values[2] + 0.587 * values[1] + 0.114 * values[0]) * 0.5;
+}
+
+double Quadtree::momentLowerBound(const BlockMoments& partial, int blockPixels, bool smallBlock) {
+    // Lower bounds of the final error from the rows read so far. The squared deviation of a
+    // subset around its own mean never exceeds its share of the block's squared deviation.
+    double partialSse = partial.sse(0) + partial.sse(1) + partial.sse(2);
+    
+    switch (errorMethod) {
+        case ErrorMethod::VARIANCE:
+            return partialSse / (3.0 * blockPixels);
+        case ErrorMethod::MAX_PIXEL_DIFF:
+            return partial.maxPixelDiff();
+        case ErrorMethod::MAD:
+            // |d| >= d^2 / 255
+            return partialSse / 255.0 / (3.0 * blockPixels);
+        case ErrorMethod::SSIM: {
+            if (smallBlock) return partialSse / (3.0 * blockPixels) / 1000.0;
+            
+            // Against a uniform block, 1 - SSIM >= sigma^2 / (sigma^2 + C2)
+            const double C2 = pow(0.03 * 255.0, 2);
+            const double weights[3] = {0.114, 0.587, 0.299};
+            double bound = 0.0;
+            for (int c = 0; c < 3; c++) {
+                double sigmaSq = partial.sse(c) / (blockPixels - 1);
+                bound += weights[c] * sigmaSq / (sigmaSq + C2);
+            }
+            return bound * 0.5;
+        }
+        default:
+            return 0.0;
+    }
+}
+
+double Quadtree::ssimFromMoments(const BlockMoments& moments, bool smallBlock) {
+    if (smallBlock) return moments.variance() / 1000.0;
+    
+    // calculateSSIM against the uniform avgColor block: sigma2 and sigma12 vanish
+    const double C1 = pow(0.01 * 255.0, 2);
+    const double C2 = pow(0.03 * 255.0, 2);
+    Vec3b avgColor = moments.meanColor();
+    double values[3];
+    
+    for (int c = 0; c < 3; c++) {
+        double mu1 = moments.mean(c);
+        double mu2 = avgColor[c];
+        double sigma1_sq = moments.count > 1 ? moments.sse(c) / (moments.count - 1) : 0.0;
+        
+        double numerator = (2 * mu1 * mu2 + C1) * C2;
+        double denominator = (mu1 * mu1 + mu2 * mu2 + C1) * (sigma1_sq + C2);
+        double ssim = denominator > 0.001 ? numerator / denominator : 0.99;
+        values[c] = std::max(0.0, std::min(1.0, 1.0 - ssim));
+    }
+    
+    return (0.299 * values[2] + 0.587 * values[1] + 0.114 * values[0]) * 0.5;
+}
+
+bool Quadtree::boundedMAD(const Mat& block, const BlockMoments& total, double limit) {
+    double mu[3] = {total.mean(0), total.mean(1), total.mean(2)};
+    double limitSum = limit * 3.0 * block.rows * block.cols;
+    double madSum = 0.0;
+    
+    for (int i = 0; i < block.rows; i++) {
+        const Vec3b* row = block.ptr<Vec3b>(i);
+        for (int j = 0; j < block.cols; j++) {
+            madSum += std::abs(row[j][0] - mu[0]) + std::abs(row[j][1] - mu[1]) + std::abs(row[j][2] - mu[2]);
+        }
+        if (madSum >= limitSum) return true;
+    }
+    return false;
+}
+
+bool Quadtree::boundedEntropy(const Mat& block, double limit) {
+    int blockPixels = block.rows * block.cols;
+    int hist[768] = {0};
+    int samples = 0;
+    
+    auto entropyOf = [&hist](int sampleCount) {
+        double entropy = 0.0;
+        for (int i = 0; i < 768; i++) {
+            if (hist[i] > 0) {
+                double p = (double)hist[i] / sampleCount;
+                entropy -= p * log2(p);
+            }
+        }
+        return std::min(entropy / 3.0, 5.0);
+    };
+    
+    for (int i = 0; i < block.rows; i++) {
+        const Vec3b* row = block.ptr<Vec3b>(i);
+        for (int j = 0; j < block.cols; j++) {
+            hist[row[j][0]]++;
+            hist[256 + row[j][1]]++;
+            hist[512 + row[j][2]]++;
+        }
+        samples += block.cols;
+        
+        // Entropy is concave, so the rows read so far contribute at least their share of it
+        if ((i & 7) == 7 && samples < blockPixels &&
+            (double)samples / blockPixels * entropyOf(samples) >= limit) {
+            return true;
+        }
+    }
+    
+    return entropyOf(samples) >= limit;
+}
+
+// Radical inverse of index in the given base, for Halton points
+static double radicalInverse(int index, int base) {
+    double result = 0.0;
+    double f = 1.0 / base;
+    while (index > 0) {
+        result += f * (index % base);
+        index /= base;
+        f /= base;
+    }
+    return result;
+}
+
+bool Quadtree::sampledErrorReaches(const Mat& block, double limit, bool smallBlock) {
+    // Only ever confirms a split: a block that stays a leaf needs the exact scan for its color
+    int n = samplingCount;
+    vector<Vec3b> localSamples;
+    vector<Vec3b>& samples = arena ? arena->samples : localSamples;
+    samples.resize(n);
+    
+    for (int k = 0; k < n; k++) {
+        double u = radicalInverse(k + 1, 2) + samplingOffset.x;
+        double v = radicalInverse(k + 1, 3) + samplingOffset.y;
+        u -= floor(u);
+        v -= floor(v);
+        int px = std::min(block.cols - 1, static_cast<int>(u * block.cols));
+        int py = std::min(block.rows - 1, static_cast<int>(v * block.rows));
+        samples[k] = block.at<Vec3b>(py, px);
+    }
+    
+    const double z = samplingConfidence;
+    
+    if (errorMethod == ErrorMethod::MAX_PIXEL_DIFF) {
+        // The range of any subset is a hard lower bound
+        BlockMoments moments;
+        for (const Vec3b& s : samples) moments.add(s);
+        return moments.maxPixelDiff() >= limit;
+    }
+    
+    if (errorMethod == ErrorMethod::ENTROPY) {
+        // Plug-in entropy is biased low, so the lower confidence bound stays conservative
+        int hist[768] = {0};
+        for (const Vec3b& s : samples) {
+            hist[s[0]]++;
+            hist[256 + s[1]]++;
+            hist[512 + s[2]]++;
+        }
+        
+        double estimate = 0.0, spread = 0.0;
+        for (int c = 0; c < 3; c++) {
+            double h = 0.0, h2 = 0.0;
+            for (int i = 256 * c; i < 256 * (c + 1); i++) {
+                if (hist[i] == 0) continue;
+                double p = (double)hist[i] / n;
+                h -= p * log2(p);
+                h2 += p * log2(p) * log2(p);
+            }
+            estimate += h;
+            spread += std::max(0.0, h2 - h * h) / n;
+        }
+        estimate /= 3.0;
+        double se = sqrt(spread) / 3.0;
+        return std::min(estimate - z * se, 5.0) >= limit;
+    }
+    
+    double mu[3] = {0, 0, 0};
+    for (const Vec3b& s : samples) {
+        for (int c = 0; c < 3; c++) mu[c] += s[c];
+    }
+    for (int c = 0; c < 3; c++) mu[c] /= n;
+    
+    // Per-sample contributions t_i, whose mean estimates the error
+    double sumT = 0.0, sumT2 = 0.0;
+    double channelSq[3] = {0, 0, 0}, channelSq2[3] = {0, 0, 0};
+    for (const Vec3b& s : samples) {
+        double t = 0.0;
+        for (int c = 0; c < 3; c++) {
+            double d = s[c] - mu[c];
+            double dd = errorMethod == ErrorMethod::MAD ? std::abs(d) : d * d;
+            t += dd;
+            channelSq[c] += d * d;
+            channelSq2[c] += d * d * d * d;
+        }
+        t /= 3.0;
+        sumT += t;
+        sumT2 += t * t;
+    }
+    
+    double meanT = sumT / n;
+    double se = sqrt(std::max(0.0, sumT2 / n - meanT * meanT) / n);
+    
+    switch (errorMethod) {
+        case ErrorMethod::VARIANCE:
+            return meanT * n / (n - 1) - z * se >= limit;
+        case ErrorMethod::MAD:
+            return meanT - z * se >= limit;
+        case ErrorMethod::SSIM: {
+            if (smallBlock) return (meanT * n / (n - 1) - z * se) / 1000.0 >= limit;
+            
+            const double C2 = pow(0.03 * 255.0, 2);
+            const double weights[3] = {0.114, 0.587, 0.299};
+            double bound = 0.0;
+            for (int c = 0; c < 3; c++) {
+                double m = channelSq[c] / n;
+                double seC = sqrt(std::max(0.0, channelSq2[c] / n - m * m) / n);
+                double sigmaSq = std::max(0.0, m * n / (n - 1) - z * seC);
+                bound += weights[c] * sigmaSq / (sigmaSq + C2);
+            }
+            return bound * 0.5 >= limit;
+        }
+        default:
+            return false;
+    }
+}
+
+bool Quadtree::errorReachesThreshold(const Mat& block, double limit, int splitX, int splitY, const BlockMoments* known,
+                                     BlockMoments& total, BlockMoments childMoments[4], bool& childMomentsValid) {
+    int blockPixels = block.rows * block.cols;
+    bool smallBlock = block.rows < 4 || block.cols < 4;
+    childMomentsValid = false;
+    
+    if (known && known->count == blockPixels) {
+        // Moments came with the parent's scan, no pixel has to be read for them
+        total = *known;
+    } else {
+        // Very large blocks that clearly have to split are settled from a sample;
+        // anything close to the threshold falls through to the exact scan
+        if (useSampledEstimation && blockPixels >= samplingMinPixels && blockPixels > 4 * samplingCount &&
+            sampledErrorReaches(block, limit, smallBlock)) {
+            sampledSplits++;
+            return true;
+        }
+        
+        bool complete = BlockMoments::gatherQuadrants(block, splitX, splitY, childMoments,
+            [&](const BlockMoments* quadrants, int) {
+                if (errorMethod == ErrorMethod::ENTROPY) return true;
+                
+                BlockMoments partial = quadrants[0];
+                for (int q = 1; q < 4; q++) partial.merge(quadrants[q]);
+                return momentLowerBound(partial, blockPixels, smallBlock) < limit;
+            });
+        
+        if (!complete) return true;
+        
+        total = childMoments[0];
+        for (int q = 1; q < 4; q++) total.merge(childMoments[q]);
+        childMomentsValid = true;
+    }
+    
+    switch (errorMethod) {
+        case ErrorMethod::VARIANCE:
+            return total.variance() >= limit;
+        case ErrorMethod::MAX_PIXEL_DIFF:
+            return total.maxPixelDiff() >= limit;
+        case ErrorMethod::SSIM:
+            return ssimFromMoments(total, smallBlock) >= limit;
+        case ErrorMethod::MAD: {
+            // |d| >= d^2 / reach and mean |d| <= sqrt(mean d^2) bracket the MAD
+            double lower = 0.0, upper = 0.0;
+            for (int c = 0; c < 3; c++) {
+                double mu = total.mean(c);
+                double reach = std::max(total.maxVal[c] - mu, mu - total.minVal[c]);
+                if (reach > 0) lower += total.sse(c) / reach;
+                upper += sqrt(total.sse(c) / blockPixels);
+            }
+            lower /= 3.0 * blockPixels;
+            upper /= 3.0;
+            
+            if (lower >= limit) return true;
+            if (upper < limit) return false;
+            return boundedMAD(block, total, limit);
+        }
+        case ErrorMethod::ENTROPY:
+            if (total.isUniform()) return 0.0 >= limit;
+            return boundedEntropy(block, limit);
+        default:
+            return total.variance() >= limit;
+    }
+}
+
+double Quadtree::blockWeight(const Rect& rect) const {
+    if (importance.empty()) return 1.0;
+    // Batas bawah supaya blok berbobot 0 tetap punya ukuran dan kedalaman yang wajar
+    return std::max(1.0 / 1024, importance.meanWeight(rect & Rect(0, 0, sourceImage.cols, sourceImage.rows)));
+}
+
+bool Quadtree::weightedErrorReaches(const Mat& block, const Rect& rect, double limit, double weight, int splitX, int splitY,
+                                    const BlockMoments* known, BlockMoments& total, BlockMoments childMoments[4],
+                                    bool& childMomentsValid) {
+    if (errorMethod != ErrorMethod::VARIANCE || !importance.hasMoments()) {
+        // Other methods: the block's mean weight scales the error, i.e. divides the limit
+        return errorReachesThreshold(block, limit / weight, splitX, splitY, known, total, childMoments, childMomentsValid);
+    }
+    
+    // Weighted variance straight from the integrals, no pixel is read for the decision
+    childMomentsValid = false;
+    if (importance.weightedVariance(rect) >= limit) {
+        return true;
+    }
+    
+    gatherLeafMoments(block, splitX, splitY, known, total, childMoments);
+    return false;
+}
+
+void Quadtree::gatherLeafMoments(const Mat& block, int splitX, int splitY, const BlockMoments* known,
+                                 BlockMoments& total, BlockMoments childMoments[4]) {
+    // Leaf: its moments still give the color and the leaf error
+    if (known && known->count == block.rows * block.cols) {
+        total = *known;
+        return;
+    }
+    BlockMoments::gatherQuadrants(block, splitX, splitY, childMoments, [](const BlockMoments*, int) { return true; });
+    total = childMoments[0];
+    for (int q = 1; q < 4; q++) total.merge(childMoments[q]);
+}
+
+void Quadtree::prepareEdgeIntegrals() {
+    // Arena tables are shared with the threshold search's trial trees, so they are rebuilt per build
+    if ((!edgeIntegral.empty() && !arena) || sourceImage.empty()) return;
+    
+    // Gradient pixel di bawah batas ini dianggap noise, bukan tepi
+    const double EDGE_NOISE_FLOOR = 32.0;
+    
+    Mat gray, gradX, gradY, gradient;
+    if (arena) {
+        // Views of the right size and type: every OpenCV call below writes into them in place
+        Size size = sourceImage.size();
+        Size integralSize(size.width + 1, size.height + 1);
+        gray = arena->gray.view(size, CV_8UC1);
+        gradX = arena->gradX.view(size, CV_32F);
+        gradY = arena->gradY.view(size, CV_32F);
+        gradient = arena->gradient.view(size, CV_32F);
+        edgeIntegral = arena->edgeIntegral.view(integralSize, CV_64F);
+        colorIntegral = arena->colorIntegral.view(integralSize, CV_64FC3);
+        colorSqIntegral = arena->colorSqIntegral.view(integralSize, CV_64FC3);
+    }
+    cvtColor(sourceImage, gray, COLOR_BGR2GRAY);
+    Sobel(gray, gradX, CV_32F, 1, 0, 3);
+    Sobel(gray, gradY, CV_32F, 0, 1, 3);
+    magnitude(gradX, gradY, gradient);
+    cv::threshold(gradient, gradient, EDGE_NOISE_FLOOR, 0, THRESH_TOZERO);
+    
+    integral(gradient, edgeIntegral, CV_64F);
+    integral(sourceImage, colorIntegral, colorSqIntegral, CV_64F, CV_64F);
+}
+
+double Quadtree::edgeAwareError(const Rect& rect) const {
+    double n = static_cast<double>(rect.width) * rect.height;
+    if (n <= 0) return 0.0;
+    
+    double sse = 0;
+    for (int c = 0; c < 3; c++) {
+        double sum = ImportanceMap::rectSum(colorIntegral, rect, c);
+        double sumSq = ImportanceMap::rectSum(colorSqIntegral, rect, c);
+        sse += std::max(0.0, sumSq - sum * sum / n);
+    }
+    
+    // A step of contrast d gives a Sobel magnitude of 4d on both sides of the edge, so an
+    // edge running across the block sums to about 8d * its length: dividing by the longer
+    // side leaves roughly d however large the block is, where the variance would shrink
+    double contrast = ImportanceMap::rectSum(edgeIntegral, rect) / (8.0 * std::max(rect.width, rect.height));
+    return sse / (3.0 * n) + contrast * contrast;
+}
+
+bool Quadtree::edgeErrorReaches(const Mat& block, const Rect& rect, double limit, int splitX, int splitY,
+                                const BlockMoments* known, BlockMoments& total, BlockMoments childMoments[4],
+                                bool& childMomentsValid) {
+    childMomentsValid = false;
+    if (edgeAwareError(rect) >= limit) {
+        return true;
+    }
+    
+    gatherLeafMoments(block, splitX, splitY, known, total, childMoments);
+    return false;
+}
+
 string Quadtree::getErrorMethodName(ErrorMethod method) {
     return ::getErrorMethodName(method);
 }
@@ -416,28 +875,24 @@ void Quadtree::adjustThresholdForTargetCompression(const Mat& image) {
         cout << "  - Prediksi kompresi: " << predictedCompressionPct << "%" << endl;
         cout << "  - Batas kedalaman: " << maxDepth << endl;
         
-        if (std::abs(predictedCompressionPct - targetPct) > 10.0) {
-            useHybridCompression = true;
-            hybridCompressionTarget = targetPct;
-            
+        if (std::abs(predictedCompressionPct - targetPct) > 10.0 && importance.empty()) {
             double centerRatio = 0.4;
             if (targetPct < 40.0) centerRatio = 0.6;
             else if (targetPct > 60.0) centerRatio = 0.3;
             
             int centerWidth = static_cast<int>(image.cols * centerRatio);
             int centerHeight = static_cast<int>(image.rows * centerRatio);
-            centerRegion = Rect((image.cols - centerWidth) / 2, 
+            Rect centerRegion((image.cols - centerWidth) / 2, 
                               (image.rows - centerHeight) / 2,
                               centerWidth, centerHeight);
             
+            // Bobot tengah lebih tinggi: grid di sana lebih halus, di luar lebih kasar
+            importance.build(ImportanceMap::boxWeights(image.size(), vector<Rect>(1, centerRegion), 2.0, 0.5),
+                             sourceImage.size());
+            solverImportance = true;
+            
             cout << "  - Region tengah: " << centerRegion.width << "x" << centerRegion.height 
                  << " dengan detail tinggi" << endl;
-                 
-            centerMinBlockSize = max(2, powerOf2 / 2);
-            centerMaxDepth = 10;
-            
-            outerMinBlockSize = powerOf2 * 2;
-            outerMaxDepth = min(4, maxDepth - 1);
         }
         
         return;
@@ -486,18 +941,24 @@ void Quadtree::adjustThresholdForTargetCompression(const Mat& image) {
     double scale = 1.0;
     if (image.rows * image.cols > 1000000) {
         scale = 0.5;
+        if (arena) {
+            testImage = arena->solverImage.view(Size(cvRound(image.cols * scale), cvRound(image.rows * scale)),
+                                                image.type());
+        }
         resize(image, testImage, Size(), scale, scale, INTER_AREA);
     } else {
-        testImage = image.clone();
+        testImage = arena ? image : image.clone();
     }
     
     double currentPct = 0.0;
     {
-        Quadtree tempTree(testImage, threshold, minBlockSize, errorMethod, 0.0, false);
+        Quadtree tempTree(testImage, threshold, minBlockSize, errorMethod, 0.0, false, arena);
+        tempTree.setBintreeMode(useBintree);
+        tempTree.setCancellationToken(cancelToken);
         tempTree.compressImage();
         
         int totalPixels = testImage.rows * testImage.cols;
-        int leafNodes = tempTree.countLeafNodes(tempTree.getRoot());
+        int leafNodes = tempTree.getLeafCount();
         currentPct = (1.0 - (double)leafNodes / totalPixels) * 100.0;
         
         double difference = abs(currentPct - targetPct);
@@ -531,17 +992,19 @@ void Quadtree::adjustThresholdForTargetCompression(const Mat& image) {
         
         threshold = low + (high - low) * weight;
         
-        if (abs(threshold - bestThreshold) < 0.001 * bestThreshold) {
+        if (isCancelled() || abs(threshold - bestThreshold) < 0.001 * bestThreshold) {
             break;
         }
         
         cout << "Iteration " << iter+1 << ": Testing threshold = " << threshold << endl;
         
-        Quadtree tempTree(testImage, threshold, minBlockSize, errorMethod, 0.0, false);
+        Quadtree tempTree(testImage, threshold, minBlockSize, errorMethod, 0.0, false, arena);
+        tempTree.setBintreeMode(useBintree);
+        tempTree.setCancellationToken(cancelToken);
         tempTree.compressImage();
         
         int totalPixels = testImage.rows * testImage.cols;
-        int leafNodes = tempTree.countLeafNodes(tempTree.getRoot());
+        int leafNodes = tempTree.getLeafCount();
         currentPct = (1.0 - (double)leafNodes / totalPixels) * 100.0;
         
         cout << "  Current compression: " << currentPct << "%" << endl;
@@ -568,7 +1031,7 @@ void Quadtree::adjustThresholdForTargetCompression(const Mat& image) {
         }
     }
     
-    if (bestDifference > tolerance) {
+    if (bestDifference > tolerance && !isCancelled()) {
         double extrapolatedThreshold = bestThreshold;
         if (currentPct < targetPct) {
             extrapolatedThreshold = bestThreshold * (targetPct / currentPct);
@@ -580,11 +1043,13 @@ void Quadtree::adjustThresholdForTargetCompression(const Mat& image) {
         
         cout << "Fine-tuning with threshold = " << extrapolatedThreshold << endl;
         
-        Quadtree tempTree(testImage, extrapolatedThreshold, minBlockSize, errorMethod, 0.0, false);
+        Quadtree tempTree(testImage, extrapolatedThreshold, minBlockSize, errorMethod, 0.0, false, arena);
+        tempTree.setBintreeMode(useBintree);
+        tempTree.setCancellationToken(cancelToken);
         tempTree.compressImage();
         
         int totalPixels = testImage.rows * testImage.cols;
-        int leafNodes = tempTree.countLeafNodes(tempTree.getRoot());
+        int leafNodes = tempTree.getLeafCount();
         double extrapolatedPct = (1.0 - (double)leafNodes / totalPixels) * 100.0;
         
         double extrapolatedDiff = abs(extrapolatedPct - targetPct);
@@ -599,92 +1064,101 @@ void Quadtree::adjustThresholdForTargetCompression(const Mat& image) {
     cout << "Estimated final compression: within " << bestDifference << "% of target" << endl;
 }
 
-void Quadtree::captureFrameForGif(const Mat& currentImage) {
-    if (!visualizeGif) return;
+double Quadtree::getBuildPsnr() const {
+    return psnrFromMse(buildStats.getMse());
+}
+
+void Quadtree::reportProgress(bool force) {
+    if (!progressCallback) return;
     
-    static int frameCounter = 0;
-    frameCounter++;
+    long long now = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    long long due = nextProgressReport;
+    if (!force && now < due) return;
+    // One thread wins the slot; the others skip this round instead of waiting
+    if (!nextProgressReport.compare_exchange_strong(due, now + progressIntervalMs) && !force) return;
     
-    bool shouldCapture = false;
-    if (gifFrames.size() < 5) {
-        shouldCapture = true;
-    } else if (frameCounter % 10 == 0 && gifFrames.size() < 30) {
-        shouldCapture = true;
-    } else if (frameCounter % 30 == 0 && gifFrames.size() < 60) {
-        shouldCapture = true;
+    progressCallback(getProgress());
+}
+
+double Quadtree::getProgress() const {
+    double total = static_cast<double>(sourceImage.rows) * sourceImage.cols;
+    return total > 0 ? std::min(1.0, pixelsFinalized / total) : 1.0;
+}
+
+bool Quadtree::hasCompleteDistortion() const {
+    return buildStats.getCoveredPixels() == static_cast<long long>(sourceImage.rows) * sourceImage.cols;
+}
+
+void Quadtree::recordSplitEvent(const Mat& image, QuadtreeNode* node, int depth, BuildStats& stats) {
+    if (!node->isLeaf) {
+        // Children are recorded first, so the parent color can be derived from them
+        double sum[3] = {0, 0, 0};
+        double area = 0;
+        for (int i = 0; i < 4; i++) {
+            QuadtreeNode* child = node->children[i];
+            if (!child) continue;
+            
+            int w = std::min(child->x + child->width, image.cols) - child->x;
+            int h = std::min(child->y + child->height, image.rows) - child->y;
+            if (w <= 0 || h <= 0) continue;
+            
+            double a = static_cast<double>(w) * h;
+            for (int c = 0; c < 3; c++) {
+                sum[c] += child->avgColor[c] * a;
+            }
+            area += a;
+        }
+        
+        if (area > 0) {
+            node->avgColor = Vec3b(
+                static_cast<uchar>(sum[0] / area),
+                static_cast<uchar>(sum[1] / area),
+                static_cast<uchar>(sum[2] / area)
+            );
+        }
     }
     
-    if (!shouldCapture) return;
-    
-    int targetWidth = 640;
-    int targetHeight = 480;
-    
-    double scaleX = static_cast<double>(targetWidth) / std::max(1, currentImage.cols);
-    double scaleY = static_cast<double>(targetHeight) / std::max(1, currentImage.rows);
-    double scale = std::min(scaleX, scaleY);
+    // Into the worker's own stats: no lock per event, merged at the join like the counts
+    stats.recordSplitEvent(SplitEventLog::makeEvent(node->x, node->y, node->width, node->height, depth,
+                                                    node->isLeaf, node->avgColor));
+}
+
+void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, BuildStats& stats, int depth, const BlockMoments* known) {
+    compressNode(image, node, depth, stats, known);
     
-    Mat frame;
-    if (scale < 1.0) {
-        resize(currentImage, frame, Size(), scale, scale, INTER_AREA);
-    } else {
-        frame = currentImage.clone();
+    if (node && node->isLeaf) {
+        pixelsFinalized += static_cast<long long>(node->width) * node->height;
+        reportProgress();
     }
     
-    Mat visImage = frame.clone();
-    drawQuadtreeVisualization(visImage, root, 0);
-    
-    string infoText = "Frame " + to_string(gifFrames.size() + 1);
-    putText(visImage, infoText, Point(10, 20), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0,0,255), 1);
-    
-    gifFrames.push_back(visImage);
+    if (visualizeGif && node) {
+        recordSplitEvent(image, node, depth, stats);
+    }
 }
 
-void Quadtree::drawQuadtreeVisualization(Mat& image, QuadtreeNode* node, int depth) {
-    if (!node || depth > 10) return;
-    
-    Rect rect(node->x, node->y, node->width, node->height);
-    
-    rect = rect & Rect(0, 0, image.cols, image.rows);
-    
-    if (rect.width <= 0 || rect.height <= 0) return;
+BlockMoments Quadtree::setLeafColor(QuadtreeNode* node, const Mat& image, const BlockMoments* known) {
+    if (known && known->count > 0) {
+        node->avgColor = known->meanColor();
+        return *known;
+    }
     
-    if (node->isLeaf) {
-        rectangle(image, rect, node->avgColor, FILLED);
-        if (node->width >= 8 && node->height >= 8) {
-            rectangle(image, rect, Scalar(0, 255, 0), 1);
-        }
-    } else {
-        Scalar color;
-        int depthMod = depth % 3;
-        switch (depthMod) {
-            case 0: color = Scalar(255, 0, 0);   break;
-            case 1: color = Scalar(0, 0, 255);   break;
-            case 2: color = Scalar(0, 165, 255); break;
-            default: color = Scalar(255, 255, 255); break;
-        }
-        
-        rectangle(image, rect, color, 1);
-        
-        int midX = rect.x + rect.width / 2;
-        int midY = rect.y + rect.height / 2;
-        
-        line(image, Point(midX, rect.y), Point(midX, rect.y + rect.height), color, 1);
-        line(image, Point(rect.x, midY), Point(rect.x + rect.width, midY), color, 1);
-        
-        if (depth < 8) {
-            for (int i = 0; i < 4; i++) {
-                if (node->children[i]) {
-                    drawQuadtreeVisualization(image, node->children[i], depth + 1);
-                }
-            }
+    // Same pass as calculateAverageColor, the squares come along for the leaf error
+    BlockMoments moments;
+    Rect rect = Rect(node->x, node->y, node->width, node->height) & Rect(0, 0, image.cols, image.rows);
+    for (int i = rect.y; i < rect.y + rect.height; i++) {
+        const Vec3b* row = image.ptr<Vec3b>(i);
+        for (int j = rect.x; j < rect.x + rect.width; j++) {
+            moments.add(row[j]);
         }
     }
+    node->avgColor = moments.meanColor();
+    return moments;
 }
 
-void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
+void Quadtree::compressNode(Mat& image, QuadtreeNode* node, int depth, BuildStats& stats, const BlockMoments* known) {
     const int MAX_NODES = 150000;
     
-    if (timeoutFlag || nodeCounter > MAX_NODES) return;
+    if (shouldStop() || nodeCounter > MAX_NODES) return;
     if (!node) return;
     
     // Jika posisi node invalid
@@ -693,58 +1167,22 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
         return;
     }
     
-    // Untuk hybrid compression
-    if ((useHybridCompression || forceLowCompression) && targetCompressionPct <= 0.0) {
-        useHybridCompression = false;
+    if (forceLowCompression && targetCompressionPct <= 0.0) {
         forceLowCompression = false;
     }
     
-    // Kode untuk hybrid compression dan force low compression tetap sama
-    if (useHybridCompression && targetCompressionPct > 0.0) {
-        Rect nodeRect(node->x, node->y, node->width, node->height);
-        bool isInCenterRegion = (nodeRect & centerRegion).area() > 0;
-        
-        int currentMaxDepth = isInCenterRegion ? centerMaxDepth : outerMaxDepth;
-        int currentMinBlockSize = isInCenterRegion ? centerMinBlockSize : outerMinBlockSize;
-        
-        if (depth > currentMaxDepth || node->width <= currentMinBlockSize || node->height <= currentMinBlockSize) {
-            node->calculateAverageColor(image);
-            node->isLeaf = true;
-            return;
-        }
-        
-        node->isLeaf = false;
-        nodeCounter += 4;
-        
-        int halfWidth = max(1, node->width / 2);
-        int halfHeight = max(1, node->height / 2);
-        
-        if (visualizeGif && (depth <= 2)) {
-            Rect rect(node->x, node->y, node->width, node->height);
-            rect = rect & Rect(0, 0, image.cols, image.rows);
-            if (rect.width > 0 && rect.height > 0) {
-                Mat visImage = image.clone();
-                rectangle(visImage, rect, Scalar(0, 0, 255), 2);
-                captureFrameForGif(visImage);
-            }
-        }
-        
-        node->children[0] = new QuadtreeNode(node->x, node->y, halfWidth, halfHeight);
-        node->children[1] = new QuadtreeNode(node->x + halfWidth, node->y, node->width - halfWidth, halfHeight);
-        node->children[2] = new QuadtreeNode(node->x, node->y + halfHeight, halfWidth, node->height - halfHeight);
-        node->children[3] = new QuadtreeNode(node->x + halfWidth, node->y + halfHeight, node->width - halfWidth, node->height - halfHeight);
-        
-        for (int i = 0; i < 4; i++) {
-            quadtreeCompress(image, node->children[i], depth + 1);
-            
-            if (timeoutFlag) break;
+    if (forceLowCompression && targetCompressionPct > 0.0) {
+        // Importance menggeser grid: blok lebih kecil dan lebih dalam di bagian yang penting
+        int nodeMinBlockSize = minBlockSize;
+        int nodeMaxDepth = maxDepth;
+        if (!importance.empty()) {
+            double weight = blockWeight(Rect(node->x, node->y, node->width, node->height));
+            nodeMinBlockSize = max(2, static_cast<int>(minBlockSize / weight));
+            nodeMaxDepth = maxDepth + static_cast<int>(std::round(std::log2(weight)));
         }
         
-        return;
-    }
-    else if (forceLowCompression && targetCompressionPct > 0.0) {
-        if (node->width <= minBlockSize || node->height <= minBlockSize || depth >= maxDepth) {
-            node->calculateAverageColor(image);
+        if (node->width <= nodeMinBlockSize || node->height <= nodeMinBlockSize || depth >= nodeMaxDepth) {
+            stats.recordLeafError(setLeafColor(node, image, nullptr), node->avgColor);
             node->isLeaf = true;
             return;
         }
@@ -755,25 +1193,16 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
         int halfWidth = max(1, node->width / 2);
         int halfHeight = max(1, node->height / 2);
         
-        if (visualizeGif && (depth <= 2)) {
-            Rect rect(node->x, node->y, node->width, node->height);
-            rect = rect & Rect(0, 0, image.cols, image.rows);
-            if (rect.width > 0 && rect.height > 0) {
-                Mat visImage = image.clone();
-                rectangle(visImage, rect, Scalar(0, 0, 255), 2);
-                captureFrameForGif(visImage);
-            }
-        }
-        
-        node->children[0] = new QuadtreeNode(node->x, node->y, halfWidth, halfHeight);
-        node->children[1] = new QuadtreeNode(node->x + halfWidth, node->y, node->width - halfWidth, halfHeight);
-        node->children[2] = new QuadtreeNode(node->x, node->y + halfHeight, halfWidth, node->height - halfHeight);
-        node->children[3] = new QuadtreeNode(node->x + halfWidth, node->y + halfHeight, node->width - halfWidth, node->height - halfHeight);
+        node->children[0] = newNode(node->x, node->y, halfWidth, halfHeight);
+        node->children[1] = newNode(node->x + halfWidth, node->y, node->width - halfWidth, halfHeight);
+        node->children[2] = newNode(node->x, node->y + halfHeight, halfWidth, node->height - halfHeight);
+        node->children[3] = newNode(node->x + halfWidth, node->y + halfHeight, node->width - halfWidth, node->height - halfHeight);
+        stats.recordSplit(depth);
         
         for (int i = 0; i < 4; i++) {
-            quadtreeCompress(image, node->children[i], depth + 1);
+            quadtreeCompress(image, node->children[i], stats, depth + 1);
             
-            if (timeoutFlag) break;
+            if (shouldStop()) break;
         }
         
         return;
@@ -783,14 +1212,14 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
     if (minBlockSize == 2) {
         // Jika sudah mencapai batas kedalaman maksimum
         if (depth > maxDepth) {
-            node->calculateAverageColor(image);
+            stats.recordLeafError(setLeafColor(node, image, known), node->avgColor);
             node->isLeaf = true;
             return;
         }
         
         // Jika ukuran node terlalu kecil untuk dibagi lagi
         if (node->width < 4 || node->height < 4) {
-            node->calculateAverageColor(image);
+            stats.recordLeafError(setLeafColor(node, image, known), node->avgColor);
             node->isLeaf = true;
             return;
         }
@@ -814,8 +1243,21 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
         
         Rect rect(startX, startY, endX - startX, endY - startY);
         
+        // Sesuaikan threshold berdasarkan ukuran blok
+        double adjusted_threshold = threshold;
+        if (rect.width * rect.height <= 36) { // 6x6 atau lebih kecil
+            adjusted_threshold = threshold * 1.5; // Lebih toleran terhadap error untuk blok kecil
+        }
+        
+        // Cek apakah ukuran anak-anak valid
+        int halfWidth = max(2, node->width / 2);
+        int halfHeight = max(2, node->height / 2);
+        
         // Hitung error dan check subdivisi
-        double error;
+        bool split;
+        BlockMoments leafMoments;   // Lengkap setiap kali blok tidak dibagi
+        BlockMoments childMoments[4];
+        bool childMomentsValid = false;
         try {
             if (rect.width <= 0 || rect.height <= 0 || 
                 rect.x + rect.width > image.cols || rect.y + rect.height > image.rows) {
@@ -824,18 +1266,31 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
             }
             
             Mat block = image(rect);
-            node->calculateAverageColor(image);
+            double weight = blockWeight(rect);
             
             // Perhitungan error untuk blok kecil dengan pendekatan khusus
             if (rect.width * rect.height <= 16) { // Ukuran blok 4x4 atau lebih kecil
                 // Gunakan metode MaxPixelDiff untuk blok kecil karena lebih stabil
-                error = calculateMaxPixelDiff(block) * 0.5;
-            } else if (errorMethod == ErrorMethod::SSIM) {
-                Mat avgBlock = Mat(block.size(), block.type(), 
-                            Scalar(node->avgColor[0], node->avgColor[1], node->avgColor[2]));
-                error = calculateError(block, avgBlock);
+                leafMoments = setLeafColor(node, image, known);
+                split = calculateMaxPixelDiff(block) * 0.5 * weight >= adjusted_threshold;
+            } else if (errorMethod == ErrorMethod::EDGE_AWARE) {
+                split = edgeErrorReaches(block, rect, adjusted_threshold / weight, halfWidth, halfHeight, known,
+                                         leafMoments, childMoments, childMomentsValid);
+                if (leafMoments.count > 0) {
+                    node->avgColor = leafMoments.meanColor();
+                }
+            } else if (!importance.empty()) {
+                split = weightedErrorReaches(block, rect, adjusted_threshold, weight, halfWidth, halfHeight, known,
+                                             leafMoments, childMoments, childMomentsValid);
+                if (leafMoments.count > 0) {
+                    node->avgColor = leafMoments.meanColor();
+                }
             } else {
-                error = calculateError(block);
+                split = errorReachesThreshold(block, adjusted_threshold, halfWidth, halfHeight, known,
+                                              leafMoments, childMoments, childMomentsValid);
+                if (leafMoments.count > 0) {
+                    node->avgColor = leafMoments.meanColor();
+                }
             }
         } catch (const cv::Exception& e) {
             cout << "Warning: " << e.what() << endl;
@@ -843,23 +1298,16 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
             return;
         }
         
-        // Sesuaikan threshold berdasarkan ukuran blok
-        double adjusted_threshold = threshold;
-        if (rect.width * rect.height <= 36) { // 6x6 atau lebih kecil
-            adjusted_threshold = threshold * 1.5; // Lebih toleran terhadap error untuk blok kecil
-        }
-        
-        if (error < adjusted_threshold) {
+        if (!split) {
+            stats.recordLeafError(leafMoments, node->avgColor);
             node->isLeaf = true;
             return;
         }
         
-        // Cek apakah ukuran anak-anak valid
-        int halfWidth = max(2, node->width / 2);
-        int halfHeight = max(2, node->height / 2);
-        
         // Jika ukuran anak terlalu kecil, jangan bagi lagi
         if (halfWidth < 2 || halfHeight < 2) {
+            stats.recordLeafError(leafMoments.count > 0 ? leafMoments : setLeafColor(node, image, nullptr),
+                                  node->avgColor);
             node->isLeaf = true;
             return;
         }
@@ -867,28 +1315,23 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
         node->isLeaf = false;
         nodeCounter += 4;
         
-        bool shouldCaptureFrame = visualizeGif && (depth <= 2 || depth == 4 || depth == 6);
-        if (shouldCaptureFrame) {
-            Mat visImage = image.clone();
-            rectangle(visImage, rect, Scalar(0, 0, 255), 2);
-            captureFrameForGif(visImage);
-        }
-        
         // Buat node anak dengan ukuran minimum 2x2
-        node->children[0] = new QuadtreeNode(node->x, node->y, halfWidth, halfHeight);
-        node->children[1] = new QuadtreeNode(node->x + halfWidth, node->y, max(2, node->width - halfWidth), halfHeight);
-        node->children[2] = new QuadtreeNode(node->x, node->y + halfHeight, halfWidth, max(2, node->height - halfHeight));
-        node->children[3] = new QuadtreeNode(node->x + halfWidth, node->y + halfHeight, max(2, node->width - halfWidth), max(2, node->height - halfHeight));
+        node->children[0] = newNode(node->x, node->y, halfWidth, halfHeight);
+        node->children[1] = newNode(node->x + halfWidth, node->y, max(2, node->width - halfWidth), halfHeight);
+        node->children[2] = newNode(node->x, node->y + halfHeight, halfWidth, max(2, node->height - halfHeight));
+        node->children[3] = newNode(node->x + halfWidth, node->y + halfHeight, max(2, node->width - halfWidth), max(2, node->height - halfHeight));
+        stats.recordSplit(depth);
         
         // Rekursi untuk setiap anak
         for (int i = 0; i < 4; i++) {
-            quadtreeCompress(image, node->children[i], depth + 1);
-            if (timeoutFlag) break;
+            quadtreeCompress(image, node->children[i], stats, depth + 1,
+                             childMomentsValid ? &childMoments[i] : nullptr);
+            if (shouldStop()) break;
         }
     } else {
         // KODE ORIGINAL UNTUK UKURAN > 2
         if (depth > maxDepth || node->width <= minBlockSize || node->height <= minBlockSize) {
-            node->calculateAverageColor(image);
+            stats.recordLeafError(setLeafColor(node, image, known), node->avgColor);
             node->isLeaf = true;
             return;
         }
@@ -898,8 +1341,6 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
             return;
         }
         
-        bool shouldCaptureFrame = visualizeGif && (depth <= 2 || depth == 4 || depth == 6);
-        
         int endX = std::min(node->x + node->width, image.cols);
         int endY = std::min(node->y + node->height, image.rows);
         int startX = std::max(0, node->x);
@@ -912,7 +1353,13 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
         
         Rect rect(startX, startY, endX - startX, endY - startY);
         
-        double error;
+        int halfWidth = max(1, node->width / 2);
+        int halfHeight = max(1, node->height / 2);
+        
+        bool split;
+        BlockMoments leafMoments;
+        BlockMoments childMoments[4];
+        bool childMomentsValid = false;
         try {
             if (rect.width <= 0 || rect.height <= 0 || 
                 rect.x + rect.width > image.cols || rect.y + rect.height > image.rows) {
@@ -921,14 +1368,30 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
             }
             
             Mat block = image(rect);
-            node->calculateAverageColor(image);
+            double weight = blockWeight(rect);
             
-            if (errorMethod == ErrorMethod::SSIM) {
-                Mat avgBlock = Mat(block.size(), block.type(), 
-                            Scalar(node->avgColor[0], node->avgColor[1], node->avgColor[2]));
-                error = calculateError(block, avgBlock);
+            if (rect.width * rect.height < 16) {
+                // Blok kecil: metrik khusus di calculateError, hitung langsung
+                leafMoments = setLeafColor(node, image, known);
+                split = calculateError(block) * weight >= threshold;
+            } else if (errorMethod == ErrorMethod::EDGE_AWARE) {
+                split = edgeErrorReaches(block, rect, threshold / weight, halfWidth, halfHeight, known,
+                                         leafMoments, childMoments, childMomentsValid);
+                if (leafMoments.count > 0) {
+                    node->avgColor = leafMoments.meanColor();
+                }
+            } else if (!importance.empty()) {
+                split = weightedErrorReaches(block, rect, threshold, weight, halfWidth, halfHeight, known,
+                                             leafMoments, childMoments, childMomentsValid);
+                if (leafMoments.count > 0) {
+                    node->avgColor = leafMoments.meanColor();
+                }
             } else {
-                error = calculateError(block);
+                split = errorReachesThreshold(block, threshold, halfWidth, halfHeight, known,
+                                              leafMoments, childMoments, childMomentsValid);
+                if (leafMoments.count > 0) {
+                    node->avgColor = leafMoments.meanColor();
+                }
             }
         } catch (const cv::Exception& e) {
             cout << "Warning: " << e.what() << endl;
@@ -936,54 +1399,44 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
             return;
         }
         
-        if (error < threshold) {
+        if (!split) {
+            stats.recordLeafError(leafMoments, node->avgColor);
             node->isLeaf = true;
-            
-            if (shouldCaptureFrame) {
-                Mat visImage = image.clone();
-                rectangle(visImage, rect, Scalar(0, 255, 0), 1);
-                captureFrameForGif(visImage);
-            }
-            
             return;
         }
         
         node->isLeaf = false;
         nodeCounter += 4;
         
-        int halfWidth = max(1, node->width / 2);
-        int halfHeight = max(1, node->height / 2);
-        
-        if (shouldCaptureFrame) {
-            Mat visImage = image.clone();
-            rectangle(visImage, rect, Scalar(0, 0, 255), 2);
-            captureFrameForGif(visImage);
-        }
+        node->children[0] = newNode(node->x, node->y, halfWidth, halfHeight);
+        node->children[1] = newNode(node->x + halfWidth, node->y, node->width - halfWidth, halfHeight);
+        node->children[2] = newNode(node->x, node->y + halfHeight, halfWidth, node->height - halfHeight);
+        node->children[3] = newNode(node->x + halfWidth, node->y + halfHeight, node->width - halfWidth, node->height - halfHeight);
+        stats.recordSplit(depth);
         
-        node->children[0] = new QuadtreeNode(node->x, node->y, halfWidth, halfHeight);
-        node->children[1] = new QuadtreeNode(node->x + halfWidth, node->y, node->width - halfWidth, halfHeight);
-        node->children[2] = new QuadtreeNode(node->x, node->y + halfHeight, halfWidth, node->height - halfHeight);
-        node->children[3] = new QuadtreeNode(node->x + halfWidth, node->y + halfHeight, node->width - halfWidth, node->height - halfHeight);
-        
-        bool useParallel = (image.cols * image.rows > 500000) && (depth <= 1);
+        bool useParallel = (image.cols * image.rows > 500000) && (depth <= 1) && !arena;
         
         if (useParallel) {
             vector<future<void>> futures;
+            vector<BuildStats> localStats(4);
             
             for (int i = 0; i < 4; i++) {
-                futures.push_back(async(launch::async, [this, &image, i, node, depth]() {
-                    quadtreeCompress(image, node->children[i], depth + 1);
+                futures.push_back(async(launch::async, [this, &image, &localStats, &childMoments, childMomentsValid, i, node, depth]() {
+                    quadtreeCompress(image, node->children[i], localStats[i], depth + 1,
+                                     childMomentsValid ? &childMoments[i] : nullptr);
                 }));
             }
             
-            for (auto& f : futures) {
-                f.wait();
+            for (int i = 0; i < 4; i++) {
+                futures[i].wait();
+                stats.merge(localStats[i]);
             }
         } else {
             for (int i = 0; i < 4; i++) {
-                quadtreeCompress(image, node->children[i], depth + 1);
+                quadtreeCompress(image, node->children[i], stats, depth + 1,
+                                 childMomentsValid ? &childMoments[i] : nullptr);
                 
-                if (i % 2 == 1 && timeoutFlag) {
+                if (i % 2 == 1 && shouldStop()) {
                     break;
                 }
             }
@@ -991,35 +1444,514 @@ void Quadtree::quadtreeCompress(Mat& image, QuadtreeNode* node, int depth) {
     }
 }
 
+// Per-worker histogram slots for the bottom-up build, one per (depth, child index)
+struct MergeScratch {
+    vector<int> histograms;
+    BuildStats distortion;      // Errors of the leaves this worker settled
+    vector<int>* borrowed;      // Arena storage, handed back on destruction
+    
+    explicit MergeScratch(int maxDepth, vector<int>* reuse = nullptr) : borrowed(reuse) {
+        // Slots are cleared by mergeBuild before use, so reused storage is not zeroed
+        if (borrowed) histograms.swap(*borrowed);
+        size_t size = static_cast<size_t>(maxDepth + 3) * 4 * 768;
+        if (histograms.size() < size) histograms.resize(size, 0);
+    }
+    MergeScratch(const MergeScratch& other) : histograms(other.histograms), distortion(other.distortion), borrowed(nullptr) {}
+    ~MergeScratch() {
+        if (borrowed) borrowed->swap(histograms);
+    }
+    int* slot(int depth, int child) { return &histograms[(static_cast<size_t>(depth) * 4 + child) * 768]; }
+};
+
+bool Quadtree::mergedErrorReaches(const Mat& block, const Rect& rect, const BlockMoments& moments, const int* histogram) {
+    int n = moments.count;
+    double limit = threshold;
+    
+    // Same rules as the top-down paths in compressNode
+    if (minBlockSize == 2) {
+        if (n <= 36) limit = threshold * 1.5;
+        if (n <= 16) return moments.maxPixelDiff() * 0.5 >= limit;
+    } else if (n < 16) {
+        // Under 16 pixels one side is below 4, where SSIM never reads the average block
+        return calculateError(block) >= limit;
+    }
+    
+    switch (errorMethod) {
+        case ErrorMethod::VARIANCE:
+            return moments.variance() >= limit;
+        case ErrorMethod::MAX_PIXEL_DIFF:
+            return moments.maxPixelDiff() >= limit;
+        case ErrorMethod::SSIM:
+            return ssimFromMoments(moments, block.rows < 4 || block.cols < 4) >= limit;
+        case ErrorMethod::EDGE_AWARE:
+            return edgeAwareError(rect) >= limit;
+        case ErrorMethod::MAD: {
+            // Absolute deviation summed per histogram bin
+            double madSum = 0.0;
+            for (int c = 0; c < 3; c++) {
+                double mu = moments.mean(c);
+                for (int v = 0; v < 256; v++) {
+                    if (histogram[256 * c + v]) madSum += histogram[256 * c + v] * std::abs(v - mu);
+                }
+            }
+            return madSum / (3.0 * n) >= limit;
+        }
+        case ErrorMethod::ENTROPY: {
+            double entropy = 0.0;
+            for (int i = 0; i < 768; i++) {
+                if (histogram[i] > 0) {
+                    double p = (double)histogram[i] / n;
+                    entropy -= p * log2(p);
+                }
+            }
+            return std::min(entropy / 3.0, 5.0) >= limit;
+        }
+        default:
+            return moments.variance() >= limit;
+    }
+}
+
+QuadtreeNode* Quadtree::mergeBuild(const Mat& image, int x, int y, int width, int height, int depth,
+                                   MergeScratch& scratch, BlockMoments& moments, int* histogram) {
+    QuadtreeNode* node = newNode(x, y, width, height);
+    moments.clear();
+    if (histogram) {
+        std::fill(histogram, histogram + 768, 0);
+    }
+    
+    Rect rect = Rect(x, y, width, height) & Rect(0, 0, image.cols, image.rows);
+    if (rect.width <= 0 || rect.height <= 0) {
+        return node;
+    }
+    
+    // Blocks the top-down build could never split are read once, straight from the image
+    bool smallest = minBlockSize == 2
+        ? (depth > maxDepth || width < 4 || height < 4)
+        : (depth > maxDepth || width <= minBlockSize || height <= minBlockSize);
+    
+    if (smallest) {
+        for (int i = rect.y; i < rect.y + rect.height; i++) {
+            const Vec3b* row = image.ptr<Vec3b>(i);
+            for (int j = rect.x; j < rect.x + rect.width; j++) {
+                moments.add(row[j]);
+                if (histogram) {
+                    histogram[row[j][0]]++;
+                    histogram[256 + row[j][1]]++;
+                    histogram[512 + row[j][2]]++;
+                }
+            }
+        }
+        node->avgColor = moments.meanColor();
+        return node;
+    }
+    
+    int halfWidth = max(1, width / 2);
+    int halfHeight = max(1, height / 2);
+    const int childX[4] = {x, x + halfWidth, x, x + halfWidth};
+    const int childY[4] = {y, y, y + halfHeight, y + halfHeight};
+    const int childW[4] = {halfWidth, width - halfWidth, halfWidth, width - halfWidth};
+    const int childH[4] = {halfHeight, halfHeight, height - halfHeight, height - halfHeight};
+    
+    BlockMoments childMoments[4];
+    int* childHistograms[4] = {nullptr, nullptr, nullptr, nullptr};
+    
+    bool parallelRoot = depth == 0 && image.cols * image.rows > 500000 && !arena;
+    
+    if (parallelRoot) {
+        // Quadrants in parallel, each worker with its own scratch
+        vector<MergeScratch> workerScratch(4, MergeScratch(maxDepth));
+        vector<future<void>> futures;
+        for (int i = 0; i < 4; i++) {
+            if (histogram) childHistograms[i] = workerScratch[i].slot(depth + 1, i);
+            futures.push_back(async(launch::async, [&, i]() {
+                if (!useNumaPartitioning()) {
+                    node->children[i] = mergeBuild(image, childX[i], childY[i], childW[i], childH[i], depth + 1,
+                                                   workerScratch[i], childMoments[i], childHistograms[i]);
+                    return;
+                }
+                
+                // Pinned worker reading a copy of its quadrant that it touched first
+                NumaTopology::get().pinCurrentThread(i);
+                Mat local = image(Rect(childX[i], childY[i], childW[i], childH[i])).clone();
+                node->children[i] = mergeBuild(local, 0, 0, childW[i], childH[i], depth + 1,
+                                               workerScratch[i], childMoments[i], childHistograms[i]);
+                translateSubtree(node->children[i], childX[i], childY[i]);
+            }));
+        }
+        for (int i = 0; i < 4; i++) {
+            futures[i].wait();
+            scratch.distortion.merge(workerScratch[i].distortion);
+        }
+    } else {
+        for (int i = 0; i < 4; i++) {
+            if (histogram) childHistograms[i] = scratch.slot(depth + 1, i);
+            node->children[i] = mergeBuild(image, childX[i], childY[i], childW[i], childH[i], depth + 1,
+                                           scratch, childMoments[i], childHistograms[i]);
+        }
+    }
+    
+    // Statistics of the block are composed from the children, no pixel is read again
+    for (int i = 0; i < 4; i++) {
+        moments.merge(childMoments[i]);
+        if (histogram) {
+            for (int b = 0; b < 768; b++) histogram[b] += childHistograms[i][b];
+        }
+    }
+    node->avgColor = moments.meanColor();
+    
+    // A parallel root is always split, as in compressImage
+    if (parallelRoot || mergedErrorReaches(image(rect), rect, moments, histogram)) {
+        node->isLeaf = false;
+        // Children that stayed leaves are final now
+        for (int i = 0; i < 4; i++) {
+            if (node->children[i]->isLeaf) {
+                scratch.distortion.recordLeafError(childMoments[i], node->children[i]->avgColor);
+            }
+        }
+    } else {
+        // Merge: the block is good enough as one leaf
+        for (int i = 0; i < 4; i++) {
+            deleteTree(node->children[i]);
+            node->children[i] = nullptr;
+        }
+    }
+    return node;
+}
+
+void Quadtree::finishMergedTree() {
+    // The shape is only final once the root is merged, so counts and GIF events are taken here
+    class FinishVisitor : public QuadtreeVisitor {
+    public:
+        Quadtree& tree;
+        explicit FinishVisitor(Quadtree& tree) : tree(tree) {}
+        
+        bool enterNode(QuadtreeNode* node, int depth) override {
+            tree.buildStats.recordNode(depth, node->isLeaf);
+            return true;
+        }
+        void leaveNode(QuadtreeNode* node, int depth) override {
+            if (tree.visualizeGif) {
+                tree.recordSplitEvent(tree.sourceImage, node, depth, tree.buildStats);
+            }
+        }
+    } finisher(*this);
+    
+    buildStats.clear();
+    traverseQuadtree(root, finisher);
+}
+
+// A leaf of the quality-driven build that may still be split, with its quadrants' moments
+struct QualitySplit {
+    QuadtreeNode* node;
+    int depth;
+    BlockMoments quadrants[4];
+};
+
+void Quadtree::buildToQuality() {
+    const Rect bounds(0, 0, sourceImage.cols, sourceImage.rows);
+    const double pixels = static_cast<double>(sourceImage.rows) * sourceImage.cols;
+    const bool bySsim = targetPsnr <= 0.0;
+    
+    // Contribution of one leaf: minus its squared error, or its SSIM times its area
+    auto leafScore = [bySsim](const BlockMoments& moments) {
+        Vec3b color = moments.meanColor();
+        if (bySsim) return moments.ssimAgainst(color) * moments.count;
+        return -(moments.sseAgainst(0, color[0]) + moments.sseAgainst(1, color[1]) + moments.sseAgainst(2, color[2]));
+    };
+    auto floorMet = [&](double score) {
+        if (bySsim) return score / pixels >= targetSsim;
+        return psnrFromMse(-score / (3.0 * pixels)) >= targetPsnr;
+    };
+    
+    vector<QualitySplit> candidates;
+    priority_queue<pair<double, int>> queue;    // Gain of the split, index in candidates
+    
+    // Reads the node's block once for its quadrants, so its own moments and the gain of
+    // splitting it are known. Returns the node's moments.
+    auto consider = [&](QuadtreeNode* node, int depth, const BlockMoments* known) {
+        Rect rect = Rect(node->x, node->y, node->width, node->height) & bounds;
+        bool splittable = depth <= maxDepth && node->width > minBlockSize && node->height > minBlockSize &&
+                          node->width >= 2 && node->height >= 2;
+        
+        if (!splittable || rect.width <= 0 || rect.height <= 0) {
+            BlockMoments moments = known ? *known : setLeafColor(node, sourceImage, nullptr);
+            node->avgColor = moments.meanColor();
+            return moments;
+        }
+        
+        QualitySplit candidate;
+        candidate.node = node;
+        candidate.depth = depth;
+        int halfWidth = max(1, node->width / 2);
+        int halfHeight = max(1, node->height / 2);
+        BlockMoments::gatherQuadrants(sourceImage(rect), node->x + halfWidth - rect.x, node->y + halfHeight - rect.y,
+                                      candidate.quadrants, [](const BlockMoments*, int) { return true; });
+        
+        BlockMoments moments = candidate.quadrants[0];
+        double gain = 0;
+        for (int q = 0; q < 4; q++) {
+            if (q > 0) moments.merge(candidate.quadrants[q]);
+            gain += leafScore(candidate.quadrants[q]);
+        }
+        gain -= leafScore(moments);
+        node->avgColor = moments.meanColor();
+        
+        if (gain > 0) {
+            queue.push(make_pair(gain, static_cast<int>(candidates.size())));
+            candidates.push_back(candidate);
+        }
+        return moments;
+    };
+    
+    BlockMoments rootMoments = consider(root, 0, nullptr);
+    double score = leafScore(rootMoments);
+    
+    // Largest gain first, so the quality only rises and the first tree that meets the
+    // floor is the coarsest one this order reaches. Like lossless, the floor is a guarantee
+    // and ignores the timeout; only cancellation ends it early.
+    while (!floorMet(score) && !queue.empty() && !isCancelled()) {
+        const QualitySplit& candidate = candidates[queue.top().second];
+        score += queue.top().first;
+        queue.pop();
+        
+        QuadtreeNode* node = candidate.node;
+        int depth = candidate.depth;
+        BlockMoments quadrants[4];
+        for (int q = 0; q < 4; q++) quadrants[q] = candidate.quadrants[q];
+        
+        Rect childRects[4];
+        CompactQuadtree::childRects(Rect(node->x, node->y, node->width, node->height), childRects);
+        node->isLeaf = false;
+        for (int i = 0; i < 4; i++) {
+            node->children[i] = newNode(childRects[i].x, childRects[i].y,
+                                                 childRects[i].width, childRects[i].height);
+        }
+        nodeCounter += 4;
+        
+        // consider() may grow candidates, so the quadrants were copied out first
+        for (int i = 0; i < 4; i++) {
+            consider(node->children[i], depth + 1, &quadrants[i]);
+        }
+    }
+    
+    if (!floorMet(score)) {
+        if (isCancelled()) {
+            cout << "Note: quality floor not reached, the build was cancelled" << endl;
+        } else {
+            cout << "Note: quality floor not reached, the tree is at its finest allowed blocks" << endl;
+        }
+    }
+    
+    // Leaf errors of the final tree: every split node knows its children's moments
+    BuildStats distortion;
+    if (root->isLeaf) {
+        distortion.recordLeafError(rootMoments, root->avgColor);
+    }
+    for (const QualitySplit& candidate : candidates) {
+        if (candidate.node->isLeaf) continue;
+        for (int i = 0; i < 4; i++) {
+            if (candidate.node->children[i]->isLeaf) {
+                distortion.recordLeafError(candidate.quadrants[i], candidate.node->children[i]->avgColor);
+            }
+        }
+    }
+    
+    finishMergedTree();
+    buildStats.merge(distortion);
+}
+
+bool Quadtree::useNumaPartitioning() const {
+    // Split events, the importance map and the edge integrals are in image coordinates
+    // while the workers use local ones
+    return numaAware && !arena && !visualizeGif && importance.empty() && errorMethod != ErrorMethod::EDGE_AWARE &&
+           NumaTopology::get().nodeCount() > 1;
+}
+
+void Quadtree::translateSubtree(QuadtreeNode* node, int dx, int dy) {
+    class TranslateVisitor : public QuadtreeVisitor {
+    public:
+        int dx, dy;
+        TranslateVisitor(int dx, int dy) : dx(dx), dy(dy) {}
+        
+        bool enterNode(QuadtreeNode* node, int) override {
+            node->x += dx;
+            node->y += dy;
+            return true;
+        }
+    } translator(dx, dy);
+    
+    traverseQuadtree(node, translator);
+}
+
+void Quadtree::buildBottomUp() {
+    bool needHistogram = errorMethod == ErrorMethod::MAD || errorMethod == ErrorMethod::ENTROPY;
+    MergeScratch scratch(maxDepth, arena ? &arena->histograms : nullptr);
+    BlockMoments moments;
+    
+    if (root) {
+        deleteTree(root);
+    }
+    root = mergeBuild(sourceImage, 0, 0, sourceImage.cols, sourceImage.rows, 0,
+                      scratch, moments, needHistogram ? scratch.slot(0, 0) : nullptr);
+    if (root->isLeaf) {
+        scratch.distortion.recordLeafError(moments, root->avgColor);
+    }
+    finishMergedTree();
+    buildStats.merge(scratch.distortion);
+}
+
+void Quadtree::buildTree() {
+    nodeCounter = 0;
+    pixelsFinalized = 0;
+    sampledSplits = 0;
+    compactTree.clear();
+    
+    if (visualizeGif) {
+        eventLog.reset(sourceImage.size());
+    }
+    
+    if (root) {
+        deleteTree(root);
+    }
+    root = newNode(0, 0, sourceImage.cols, sourceImage.rows);
+    buildStats.reset();
+    
+    if (errorMethod == ErrorMethod::EDGE_AWARE) {
+        prepareEdgeIntegrals();
+    }
+    
+    // An arena belongs to one thread: its builds never fan out
+    bool useParallel = sourceImage.rows * sourceImage.cols > 500000 && !arena;
+    bool useBottomUp = buildStrategy == BuildStrategy::BOTTOM_UP && !forceLowCompression && importance.empty();
+    
+    if (!useBintree || lossless) {
+        bintree.clear();
+    }
+    
+    if (lossless) {
+        losslessCompress(sourceImage, root, 0, buildStats);
+    } else if (useBintree) {
+        buildBintree();
+    } else if (hasQualityTarget()) {
+        buildToQuality();
+    } else if (useBottomUp) {
+        buildBottomUp();
+    } else if (useParallel) {
+        int halfWidth = max(1, sourceImage.cols / 2);
+        int halfHeight = max(1, sourceImage.rows / 2);
+        
+        root->isLeaf = false;
+        root->children[0] = newNode(0, 0, halfWidth, halfHeight);
+        root->children[1] = newNode(halfWidth, 0, sourceImage.cols - halfWidth, halfHeight);
+        root->children[2] = newNode(0, halfHeight, halfWidth, sourceImage.rows - halfHeight);
+        root->children[3] = newNode(halfWidth, halfHeight, sourceImage.cols - halfWidth, sourceImage.rows - halfHeight);
+        buildStats.recordSplit(0);
+        
+        vector<future<void>> futures;
+        vector<BuildStats> localStats(4);
+        bool numa = useNumaPartitioning();
+        for (int i = 0; i < 4; i++) {
+            futures.push_back(async(launch::async, [this, &localStats, numa, i]() {
+                QuadtreeNode* child = root->children[i];
+                if (!numa) {
+                    quadtreeCompress(sourceImage, child, localStats[i], 1);
+                    return;
+                }
+                
+                // Pinned worker reading a copy of its quadrant that it touched first;
+                // the subtree is built in local coordinates and moved back afterwards
+                NumaTopology::get().pinCurrentThread(i);
+                Rect region(child->x, child->y, child->width, child->height);
+                Mat local = sourceImage(region).clone();
+                child->x = 0;
+                child->y = 0;
+                quadtreeCompress(local, child, localStats[i], 1);
+                translateSubtree(child, region.x, region.y);
+            }));
+        }
+        
+        for (int i = 0; i < 4; i++) {
+            futures[i].wait();
+            buildStats.merge(localStats[i]);
+        }
+        
+        if (visualizeGif) {
+            recordSplitEvent(sourceImage, root, 0, buildStats);
+        }
+    } else {
+        quadtreeCompress(sourceImage, root, buildStats);
+    }
+    
+    if (visualizeGif) {
+        eventLog.append(buildStats.getSplitEvents());
+    }
+    refreshTotals();
+}
+
+// Sets the flag once the duration has passed, unless stop() came first. Joined on
+// destruction at the latest, so the timer never outlives a short-lived tree.
+class BuildTimer {
+private:
+    mutex lock;
+    condition_variable wake;
+    bool stopped = false;
+    thread worker;
+    
+public:
+    BuildTimer(atomic<bool>& flag, chrono::milliseconds duration)
+        : worker([this, &flag, duration]() {
+              unique_lock<mutex> guard(lock);
+              if (!wake.wait_for(guard, duration, [this]() { return stopped; })) {
+                  flag = true;
+              }
+          }) {}
+    ~BuildTimer() { stop(); }
+    
+    void stop() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopped = true;
+        }
+        wake.notify_one();
+        if (worker.joinable()) worker.join();
+    }
+};
+
 void Quadtree::compressImage() {
     cout << "Compressing image using Quadtree..." << endl;
     
-    useHybridCompression = false;
     forceLowCompression = false;
+    palette.clear();
+    if (solverImportance) {
+        importance.clear();
+        solverImportance = false;
+    }
     timeoutFlag = false;
-    nodeCounter = 0;
+    pixelsFinalized = 0;
+    nextProgressReport = 0;
     maxDepth = 10;
-    gifFrames.clear();
     
     auto startTime = std::chrono::high_resolution_clock::now();
     const auto timeoutDuration = std::chrono::milliseconds(600);
     
-    thread timeoutThread([this, startTime, timeoutDuration]() {
-        while (!timeoutFlag) {
-            this_thread::sleep_for(chrono::milliseconds(100));
-            auto currentTime = chrono::high_resolution_clock::now();
-            if (chrono::duration_cast<chrono::milliseconds>(currentTime - startTime) > timeoutDuration) {
-                timeoutFlag = true;
-                break;
-            }
-        }
-    });
-    timeoutThread.detach();
+    BuildTimer timeout(timeoutFlag, timeoutDuration);
     
-    if (targetCompressionPct > 0.0) {
+    if (lossless) {
+        cout << "Mode: lossless (leaves only on uniform blocks)" << endl;
+    } else if (hasQualityTarget()) {
+        if (targetPsnr > 0.0) {
+            cout << "Target kualitas: PSNR minimal " << targetPsnr << " dB" << endl;
+        } else {
+            cout << "Target kualitas: SSIM minimal " << targetSsim << endl;
+        }
+    } else if (targetCompressionPct > 0.0) {
         if (sourceImage.rows * sourceImage.cols > 1000000) {
             Mat scaledImage;
             double scale = 0.5;
+            if (arena) {
+                scaledImage = arena->reduced.view(Size(cvRound(sourceImage.cols * scale),
+                                                       cvRound(sourceImage.rows * scale)), sourceImage.type());
+            }
             resize(sourceImage, scaledImage, Size(), scale, scale, INTER_AREA);
             
             adjustThresholdForTargetCompression(scaledImage);
@@ -1028,60 +1960,71 @@ void Quadtree::compressImage() {
         }
     }
     
-    if (visualizeGif) {
-        captureFrameForGif(sourceImage);
-    }
-    
     try {
-        cout << "Starting compression with threshold: " << threshold << endl;
-        cout << "Method: " << getErrorMethodName(errorMethod) << endl;
+        if (!hasQualityTarget() && !lossless) {
+            cout << "Starting compression with threshold: " << threshold << endl;
+            cout << "Method: " << getErrorMethodName(errorMethod) << endl;
+        }
+        if (buildStrategy == BuildStrategy::BOTTOM_UP && !forceLowCompression && importance.empty() &&
+            !hasQualityTarget() && !lossless) {
+            cout << "Build strategy: bottom-up merge" << endl;
+        }
+        if (useBintree && !lossless) {
+            cout << "Tree structure: bintree (horizontal/vertical cuts)" << endl;
+        }
+        if (!useBintree && !lossless && useNumaPartitioning() && sourceImage.rows * sourceImage.cols > 500000) {
+            cout << "NUMA-aware partitioning over " << NumaTopology::get().nodeCount() << " nodes" << endl;
+        }
         
-        if (root) {
-            deleteTree(root);
+        if (!isCancelled()) {
+            buildTree();
         }
-        root = new QuadtreeNode(0, 0, sourceImage.cols, sourceImage.rows);
         
-        bool useParallel = sourceImage.rows * sourceImage.cols > 500000;
+        if (paletteSize > 0 && !isCancelled()) {
+            applyPalette();
+        }
         
-        if (useParallel) {
-            int halfWidth = max(1, sourceImage.cols / 2);
-            int halfHeight = max(1, sourceImage.rows / 2);
-            
-            root->isLeaf = false;
-            root->children[0] = new QuadtreeNode(0, 0, halfWidth, halfHeight);
-            root->children[1] = new QuadtreeNode(halfWidth, 0, sourceImage.cols - halfWidth, halfHeight);
-            root->children[2] = new QuadtreeNode(0, halfHeight, halfWidth, sourceImage.rows - halfHeight);
-            root->children[3] = new QuadtreeNode(halfWidth, halfHeight, sourceImage.cols - halfWidth, sourceImage.rows - halfHeight);
-            
-            vector<future<void>> futures;
-            for (int i = 0; i < 4; i++) {
-                futures.push_back(async(launch::async, [this, i]() {
-                    quadtreeCompress(sourceImage, root->children[i], 1);
-                }));
-            }
-            
-            for (auto& f : futures) {
-                f.wait();
-            }
+        if (isCancelled()) {
+            cout << "Compression cancelled, the tree is incomplete" << endl;
         } else {
-            quadtreeCompress(sourceImage, root);
+            cout << "Quadtree compression completed successfully" << endl;
         }
         
-        cout << "Quadtree compression completed successfully" << endl;
-        
-        if (timeoutFlag) {
+        if (timeoutFlag && !lossless && !hasQualityTarget()) {
             cout << "Note: Compression was stopped early due to timeout" << endl;
         }
+        
+        if (sampledSplits > 0) {
+            cout << "Sampled estimation settled " << sampledSplits << " large-block splits" << endl;
+        }
+        
+        if (hasCompleteDistortion()) {
+            cout << "Tree PSNR (from leaf errors): " << getBuildPsnr() << " dB" << endl;
+        }
     } catch (const std::exception& e) {
         cout << "Error during compression: " << e.what() << endl;
     }
     
-    if (visualizeGif) {
-        Mat finalImage = sourceImage.clone();
-        drawQuadtreeVisualization(finalImage, root, 0);
-        gifFrames.push_back(finalImage);
+    timeout.stop();
+    
+    refreshTotals();
+    
+    if (useCompactStorage && !isBintree()) {
+        if (compactTree.build(root)) {
+            deleteTree(root);
+            root = nullptr;
+            cout << "Compact storage: " << compactTree.getNodeCount() << " nodes in "
+                 << compactTree.memoryBytes() << " bytes" << endl;
+        } else {
+            cout << "Compact storage not available for this tree, keeping node pointers" << endl;
+        }
     }
     
+    if (!isCancelled()) {
+        pixelsFinalized = static_cast<long long>(sourceImage.rows) * sourceImage.cols;
+    }
+    reportProgress(true);
+    
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
     
@@ -1089,81 +2032,219 @@ void Quadtree::compressImage() {
          << " in " << duration.count() << " ms" << endl;
 }
 
-void Quadtree::reconstructHelper(Mat& image, QuadtreeNode* node) {
-    if (!node) return;
+void Quadtree::reconstructImage(Mat& image, TreeSummary* summary) {
+    // Buat gambar kosong; buffer yang sudah berukuran sama dipakai ulang
+    image.create(sourceImage.size(), sourceImage.type());
+    image.setTo(Scalar::all(0));
     
-    if (node->isLeaf) {
-        int endX = std::min(node->x + node->width, image.cols);
-        int endY = std::min(node->y + node->height, image.rows);
-        int startX = std::max(0, node->x);
-        int startY = std::max(0, node->y);
-        
-        if (startX >= endX || startY >= endY) return;
-        
-        Rect region(startX, startY, endX - startX, endY - startY);
-        
-        if (region.x >= 0 && region.y >= 0 && 
-            region.x + region.width <= image.cols && 
-            region.y + region.height <= image.rows) {
-            
-            // Pendekatan berbasis rectangle untuk semua ukuran blok
-            rectangle(image, region, Scalar(node->avgColor[0], node->avgColor[1], node->avgColor[2]), FILLED);
-        }
-    } else {
-        for (int i = 0; i < 4; ++i) {
-            if (node->children[i]) {
-                reconstructHelper(image, node->children[i]);
-            }
+    if (isBintree()) {
+        bintree.reconstruct(image);
+        if (summary) {
+            *summary = summarizeTree();
         }
+        return;
+    }
+    
+    // Dari leaf tree untuk semua ukuran blok minimum (juga 2), jadi laporan kualitas dan
+    // PSNR dari leaf error mengukur hal yang sama; statistik tree dihitung pada walk yang sama
+    TreeSummary result = summarizeTree(&image);
+    if (summary) {
+        *summary = result;
     }
 }
 
-void Quadtree::reconstructImage(Mat& image) {
-    // Buat gambar kosong
-    image = Mat::zeros(sourceImage.size(), sourceImage.type());
+TreeSummary Quadtree::summarizeTree(Mat* reconstruction) {
+    if (isBintree()) {
+        TreeSummary summary;
+        summary.depth = bintree.getDepth();
+        summary.nodeCount = static_cast<int>(bintree.getNodeCount());
+        summary.leafCount = static_cast<int>(bintree.getLeafCount());
+        if (reconstruction) {
+            bintree.reconstruct(*reconstruction);
+        }
+        return summary;
+    }
     
-    if (minBlockSize == 2) {
-        // Pendekatan alternatif untuk minBlockSize 2: kita langsung buat blok lebih besar
-        // Daripada mengikuti quadtree asli yang terlalu detail
-        int blockSize = 16; // Ukuran blok yang lebih besar
-        
-        for (int y = 0; y < image.rows; y += blockSize) {
-            for (int x = 0; x < image.cols; x += blockSize) {
-                // Tentukan ukuran blok yang valid (untuk menangani tepi gambar)
-                int width = min(blockSize, image.cols - x);
-                int height = min(blockSize, image.rows - y);
-                
-                if (width <= 0 || height <= 0) continue;
-                
-                // Ambil area dari gambar sumber
-                Rect region(x, y, width, height);
-                Mat block = sourceImage(region);
-                
-                // Hitung warna rata-rata untuk blok ini
-                Scalar avgColor = mean(block);
-                
-                // Isi blok dengan warna rata-rata
-                rectangle(image, region, avgColor, FILLED);
-            }
+    if (isCompact()) {
+        TreeSummary summary;
+        summary.depth = compactTree.getDepth();
+        summary.nodeCount = static_cast<int>(compactTree.getNodeCount());
+        summary.leafCount = static_cast<int>(compactTree.getLeafCount());
+        if (reconstruction) {
+            compactTree.reconstruct(*reconstruction);
         }
-        
-        // Optional: Gunakan median blur untuk menghilangkan noise
-        medianBlur(image, image, 3);
+        return summary;
+    }
+    
+    TreeSummaryVisitor visitor(reconstruction);
+    if (sourceImage.rows * sourceImage.cols > 500000) {
+        traverseQuadtreeParallel(root, visitor);
     } else {
-        // Gunakan pendekatan quadtree normal untuk ukuran blok lebih besar
-        reconstructHelper(image, root);
+        traverseQuadtree(root, visitor);
     }
+    return visitor.getSummary();
 }
 
-int Quadtree::countLeafNodes(QuadtreeNode* node) {
-    if (!node) return 0;
-    if (node->isLeaf) return 1;
+void Quadtree::buildBintree() {
+    // Two cuts per quadtree level, so twice the depth reaches the same block sizes
+    bintree.build(sourceImage, threshold, minBlockSize, 2 * (maxDepth + 1));
     
-    int count = 0;
+    buildStats.clear();
+    for (const BintreeNode& node : bintree.getNodes()) {
+        buildStats.recordNode(node.depth, node.firstChild < 0);
+    }
+    double sse[3] = {bintree.getSse(0), bintree.getSse(1), bintree.getSse(2)};
+    buildStats.recordLeafError(sse, bintree.getCoveredPixels());
+}
+
+// All pixels of rect equal: the first row against itself shifted by one pixel, then every
+// row against the first. memcmp is vectorized and stops at the first differing byte.
+static bool isUniformBlock(const Mat& image, const Rect& rect) {
+    const size_t rowBytes = static_cast<size_t>(rect.width) * 3;
+    const uchar* first = image.ptr<uchar>(rect.y) + rect.x * 3;
+    if (rowBytes > 3 && memcmp(first, first + 3, rowBytes - 3) != 0) return false;
+    
+    for (int i = rect.y + 1; i < rect.y + rect.height; i++) {
+        if (memcmp(image.ptr<uchar>(i) + rect.x * 3, first, rowBytes) != 0) return false;
+    }
+    return true;
+}
+
+void Quadtree::losslessCompress(const Mat& image, QuadtreeNode* node, int depth, BuildStats& stats) {
+    if (isCancelled()) return;
+    
+    Rect rect(node->x, node->y, node->width, node->height);
+    if (rect.width <= 0 || rect.height <= 0) {
+        node->isLeaf = true;    // Empty half of a 1-pixel side, color set by the parent
+        return;
+    }
+    
+    if (isUniformBlock(image, rect)) {
+        node->avgColor = image.at<Vec3b>(rect.y, rect.x);
+        node->isLeaf = true;
+        const double exact[3] = {0, 0, 0};
+        stats.recordLeafError(exact, static_cast<long long>(rect.area()));
+        pixelsFinalized += rect.area();
+        reportProgress();
+        if (visualizeGif) recordSplitEvent(image, node, depth, stats);
+        return;
+    }
+    
+    node->isLeaf = false;
+    nodeCounter += 4;
+    
+    int halfWidth = max(1, node->width / 2);
+    int halfHeight = max(1, node->height / 2);
+    
+    node->children[0] = newNode(node->x, node->y, halfWidth, halfHeight);
+    node->children[1] = newNode(node->x + halfWidth, node->y, node->width - halfWidth, halfHeight);
+    node->children[2] = newNode(node->x, node->y + halfHeight, halfWidth, node->height - halfHeight);
+    node->children[3] = newNode(node->x + halfWidth, node->y + halfHeight, node->width - halfWidth, node->height - halfHeight);
+    // The halving rule keeps four children; empty halves are placeholders, not leaves
+    int nonEmpty = 0;
     for (int i = 0; i < 4; i++) {
-        count += countLeafNodes(node->children[i]);
+        node->children[i]->avgColor = image.at<Vec3b>(rect.y, rect.x);
+        if (node->children[i]->width > 0 && node->children[i]->height > 0) nonEmpty++;
+    }
+    stats.recordSplit(depth, nonEmpty);
+    
+    // No timeout or node limit here: stopping early would not be lossless
+    if (depth == 0 && rect.area() > 500000 && !arena) {
+        vector<future<void>> futures;
+        vector<BuildStats> localStats(4);
+        for (int i = 0; i < 4; i++) {
+            futures.push_back(async(launch::async, [this, &image, &localStats, node, depth, i]() {
+                losslessCompress(image, node->children[i], depth + 1, localStats[i]);
+            }));
+        }
+        for (int i = 0; i < 4; i++) {
+            futures[i].wait();
+            stats.merge(localStats[i]);
+        }
+    } else {
+        for (int i = 0; i < 4; i++) {
+            losslessCompress(image, node->children[i], depth + 1, stats);
+        }
     }
-    return count;
+    
+    if (visualizeGif) recordSplitEvent(image, node, depth, stats);
+}
+
+void Quadtree::applyPalette() {
+    // Only the leaves are touched: one color and one area per leaf
+    vector<Vec3b> colors;
+    vector<double> areas;
+    vector<QuadtreeNode*> leaves;
+    
+    if (isBintree()) {
+        for (const BintreeNode& node : bintree.getNodes()) {
+            if (node.firstChild >= 0) continue;
+            colors.push_back(node.avgColor);
+            areas.push_back(static_cast<double>(node.width) * node.height);
+        }
+    } else if (root) {
+        class LeafCollector : public QuadtreeVisitor {
+        public:
+            vector<QuadtreeNode*>& leaves;
+            explicit LeafCollector(vector<QuadtreeNode*>& leaves) : leaves(leaves) {}
+            bool enterNode(QuadtreeNode* node, int) override {
+                if (node->isLeaf) leaves.push_back(node);
+                return !node->isLeaf;
+            }
+        } collector(leaves);
+        traverseQuadtree(root, collector);
+        
+        for (QuadtreeNode* leaf : leaves) {
+            colors.push_back(leaf->avgColor);
+            areas.push_back(static_cast<double>(leaf->width) * leaf->height);
+        }
+    }
+    if (colors.empty()) return;
+    
+    auto startTime = chrono::high_resolution_clock::now();
+    palette = LeafPalette::build(colors, areas, paletteSize);
+    
+    // Leaves take their palette color, so reconstruction matches the .qtc output
+    parallel_for_(Range(0, static_cast<int>(colors.size())), [&](const Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            colors[i] = palette.color(palette.nearest(colors[i]));
+        }
+    });
+    
+    if (isBintree()) {
+        size_t next = 0;
+        const vector<BintreeNode>& nodes = bintree.getNodes();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i].firstChild < 0) bintree.setLeafColor(i, colors[next++]);
+        }
+    } else {
+        for (size_t i = 0; i < leaves.size(); i++) {
+            leaves[i]->avgColor = colors[i];
+        }
+    }
+    
+    // The leaf errors were measured against the unquantized colors
+    buildStats.clearDistortion();
+    
+    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - startTime);
+    cout << "Palette: " << palette.size() << " colors for " << colors.size() << " leaves in "
+         << duration.count() << " ms" << endl;
+}
+
+void Quadtree::refreshTotals() {
+    totalDepth = buildStats.getDepth();
+    totalNodes = 0;
+    totalLeaves = 0;
+    for (int d = 0; d < totalDepth; d++) {
+        totalNodes += buildStats.getNodeCount(d);
+        totalLeaves += buildStats.getLeafCount(d);
+    }
+}
+
+int Quadtree::countLeafNodes(QuadtreeNode* node) {
+    TreeSummaryVisitor visitor;
+    traverseQuadtree(node, visitor);
+    return visitor.getSummary().leafCount;
 }
 
 double Quadtree::calculateCompressionPercentage(const string& originalImagePath, const string& compressedImagePath) {
@@ -1186,7 +2267,7 @@ double Quadtree::calculateCompressionPercentage(const string& originalImagePath,
             return fileCompressionPct;
         } else {
             int totalPixels = sourceImage.rows * sourceImage.cols;
-            int leafNodes = countLeafNodes(root);
+            int leafNodes = getLeafCount();
             double nodeCompressionPct = (1.0 - (double)leafNodes / totalPixels) * 100.0;
             
             cout << "  Tidak dapat mendapatkan ukuran file, menggunakan kompresi berbasis node: " << nodeCompressionPct << "%" << endl;
@@ -1196,13 +2277,57 @@ double Quadtree::calculateCompressionPercentage(const string& originalImagePath,
         cout << "Error calculating compression percentage: " << e.what() << endl;
         
         int totalPixels = sourceImage.rows * sourceImage.cols;
-        int leafNodes = countLeafNodes(root);
+        int leafNodes = getLeafCount();
         return (1.0 - (double)leafNodes / totalPixels) * 100.0;
     }
 }
 
+bool Quadtree::saveContainer(const string& outputPath) {
+    if (isBintree()) {
+        ContainerHeader header;
+        header.width = static_cast<uint32_t>(sourceImage.cols);
+        header.height = static_cast<uint32_t>(sourceImage.rows);
+        header.kind = ContainerKind::BINTREE;
+        if (!palette.empty()) header.flags |= CONTAINER_FLAG_PALETTE;
+        
+        QuadtreeEncoder encoder;
+        if (!encoder.open(outputPath, header)) {
+            cout << "Error opening container for writing: " << outputPath << endl;
+            return false;
+        }
+        bool ok = palette.empty() || encoder.writePalette(palette);
+        if (outputScale > 1) ok = ok && encoder.writeScale(outputScale, outputSize);
+        ok = ok && encoder.writeBintree(bintree);
+        ok = encoder.close() && ok;
+        return ok;
+    }
+    
+    if (!root) {
+        cout << "Container output needs the node tree, not available in compact storage mode." << endl;
+        return false;
+    }
+    
+    ContainerHeader header;
+    header.width = static_cast<uint32_t>(sourceImage.cols);
+    header.height = static_cast<uint32_t>(sourceImage.rows);
+    if (!palette.empty()) header.flags |= CONTAINER_FLAG_PALETTE;
+    if (lossless) header.flags |= CONTAINER_FLAG_RUNS;
+    
+    QuadtreeEncoder encoder;
+    if (!encoder.open(outputPath, header)) {
+        cout << "Error opening container for writing: " << outputPath << endl;
+        return false;
+    }
+    
+    bool ok = palette.empty() || encoder.writePalette(palette);
+    if (outputScale > 1) ok = ok && encoder.writeScale(outputScale, outputSize);
+    ok = ok && encoder.writeTree(root);
+    ok = encoder.close() && ok;
+    return ok;
+}
+
 bool Quadtree::saveGifAnimation(const string& outputPath) {
-    if (!visualizeGif || gifFrames.empty()) {
+    if (!visualizeGif || eventLog.empty()) {
         cout << "No frames available for animation." << endl;
         return false;
     }
@@ -1246,7 +2371,7 @@ bool Quadtree::saveGifAnimation(const string& outputPath) {
     #endif
     
     try {
-        cout << "Creating GIF animation with " << gifFrames.size() << " frames..." << endl;
+        cout << "Creating GIF animation with " << replayOptions.frameCount << " frames..." << endl;
         cout << "Will save to: " << outputFilePath.string() << endl;
         
         fs::path tempDirPath;
@@ -1266,22 +2391,27 @@ bool Quadtree::saveGifAnimation(const string& outputPath) {
             cout << "Using local temp directory: " << tempDirPath.string() << endl;
         }
         
+        // Frames never exceed the source resolution
+        ReplayOptions options = replayOptions;
+        options.frameSize = Size(std::min(options.frameSize.width, sourceImage.cols),
+                                 std::min(options.frameSize.height, sourceImage.rows));
+        
         vector<fs::path> frameFilePaths;
-        for (size_t i = 0; i < gifFrames.size(); ++i) {
+        replaySplitEvents(eventLog, sourceImage, options, [&](const Mat& frame, int index) {
             stringstream ss;
-            ss << setfill('0') << setw(4) << i;
+            ss << setfill('0') << setw(4) << frameFilePaths.size();
             string frameIndex = ss.str();
             
             fs::path framePath = tempDirPath / ("frame_" + frameIndex + ".png");
-            bool writeSuccess = imwrite(framePath.string(), gifFrames[i]);
+            bool writeSuccess = imwrite(framePath.string(), frame);
             
             if (!writeSuccess) {
-                cout << "Error writing frame to: " << framePath.string() << endl;
-                continue;
+                cout << "Error writing frame " << index << " to: " << framePath.string() << endl;
+                return;
             }
             
             frameFilePaths.push_back(framePath);
-        }
+        });
         
         if (frameFilePaths.empty()) {
             cout << "Failed to save any frames." << endl;
@@ -1303,7 +2433,7 @@ bool Quadtree::saveGifAnimation(const string& outputPath) {
         tempDirPathCmd = unixTempPath + "/frame_%04d.png";
         #endif
         
-        string ffmpegCmd = "ffmpeg -y -f image2 -framerate 3 -i " + tempDirPathCmd + 
+        string ffmpegCmd = "ffmpeg -y -f image2 -framerate " + to_string(gifFrameRate) + " -i " + tempDirPathCmd + 
                            " -vf \"split[s0][s1];[s0]palettegen[p];[s1][p]paletteuse\" -loop 0 " + finalOutputPath;
         
         cout << "Executing: " << ffmpegCmd << endl;
@@ -1328,7 +2458,7 @@ bool Quadtree::saveGifAnimation(const string& outputPath) {
         
         cout << "First ffmpeg attempt failed. Trying simpler command..." << endl;
         
-        ffmpegCmd = "ffmpeg -y -f image2 -framerate 3 -i " + tempDirPathCmd + " -loop 0 " + finalOutputPath;
+        ffmpegCmd = "ffmpeg -y -f image2 -framerate " + to_string(gifFrameRate) + " -i " + tempDirPathCmd + " -loop 0 " + finalOutputPath;
         
         cout << "Executing: " << ffmpegCmd << endl;
         ffmpegResult = system(ffmpegCmd.c_str());
@@ -1382,7 +2512,7 @@ bool Quadtree::saveGifAnimation(const string& outputPath) {
             readme << "Untuk menyajikan GIF dengan ffmpeg:" << endl;
             readme << "1. Install ffmpeg" << endl;
             readme << "2. Jalankan perintah ini di direktori ini:" << endl;
-            readme << "ffmpeg -framerate 3 -i frame_%04d.png -loop 0 ../" 
+            readme << "ffmpeg -framerate " << gifFrameRate << " -i frame_%04d.png -loop 0 ../" 
                    << outputFilePath.filename().string() << endl << endl;
             
             readme.close();
@@ -1401,35 +2531,74 @@ bool Quadtree::saveGifAnimation(const string& outputPath) {
     }
 }
 
-int Quadtree::getTreeDepthHelper(QuadtreeNode* node) {
-    if (!node) return 0;
-    if (node->isLeaf) return 1;
+bool Quadtree::streamAnimation(AnimationWriter& writer, const string& outputPath, const string& formatName) {
+    if (!visualizeGif || eventLog.empty()) {
+        cout << "No frames available for animation." << endl;
+        return false;
+    }
     
-    int maxDepth = 0;
-    for (int i = 0; i < 4; i++) {
-        maxDepth = max(maxDepth, getTreeDepthHelper(node->children[i]));
+    fs::path outputFilePath = fs::absolute(fs::path(outputPath));
+    try {
+        fs::create_directories(outputFilePath.parent_path());
+    } catch (const fs::filesystem_error& e) {
+        cout << "Error creating output directory: " << e.what() << endl;
+        return false;
     }
     
-    return 1 + maxDepth;
-}
-
-int Quadtree::getNodeCountHelper(QuadtreeNode* node) {
-    if (!node) return 0;
+    ReplayOptions options = replayOptions;
+    options.frameSize = Size(std::min(options.frameSize.width, sourceImage.cols),
+                             std::min(options.frameSize.height, sourceImage.rows));
     
-    int count = 1;
-    if (!node->isLeaf) {
-        for (int i = 0; i < 4; i++) {
-            count += getNodeCountHelper(node->children[i]);
+    cout << "Creating " << formatName << " animation with " << options.frameCount << " frames..." << endl;
+    
+    // Frames go straight into the encoder, nothing is buffered
+    bool ok = true;
+    replaySplitEvents(eventLog, sourceImage, options, [&](const Mat& frame, int index) {
+        if (!ok) return;
+        if (index == 0) {
+            ok = writer.open(outputFilePath.string(), frame.size(), gifFrameRate);
+        }
+        if (ok) {
+            ok = writer.addFrame(frame);
         }
+    });
+    
+    ok = writer.close() && ok;
+    
+    if (!ok) {
+        cout << "Error writing " << formatName << " animation to: " << outputFilePath.string() << endl;
+        return false;
     }
     
-    return count;
+    cout << formatName << " successfully created!" << endl;
+    cout << "Location: " << outputFilePath.string() << endl;
+    cout << "Size: " << fs::file_size(outputFilePath) << " bytes" << endl;
+    return true;
 }
 
-int Quadtree::getTreeDepth() {
-    return getTreeDepthHelper(root);
+bool Quadtree::saveApngAnimation(const string& outputPath) {
+    ApngWriter writer;
+    return streamAnimation(writer, outputPath, "APNG");
 }
 
-int Quadtree::getNodeCount() {
-    return getNodeCountHelper(root);
-}
\ No newline at end of file
+bool Quadtree::saveWebpAnimation(const string& outputPath) {
+    WebpAnimationWriter writer;
+    return streamAnimation(writer, outputPath, "WebP");
+}
+
+bool Quadtree::saveAnimation(const string& outputPath) {
+    unique_ptr<AnimationWriter> writer = createAnimationWriter(outputPath);
+    if (!writer) {
+        return saveGifAnimation(outputPath);
+    }
+    
+    string extension = fs::path(outputPath).extension().string();
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return streamAnimation(*writer, outputPath, extension == ".webp" ? "WebP" : "APNG");
+}
+
+void Quadtree::setVisualizationOptions(int frameCount, int frameRate, Size frameSize) {
+    replayOptions.frameCount = std::max(1, frameCount);
+    replayOptions.frameSize = frameSize;
+    gifFrameRate = std::max(1, frameRate);
+}
@@ -9,6 +9,14 @@
 #include <thread>
 #include <atomic>
 #include <random>
+#include <functional>
+#include "SplitEventLog.hpp"
+#include "AnimationWriter.hpp"
+#include "CompactQuadtree.hpp"
+#include "BlockMoments.hpp"
+#include "ImportanceMap.hpp"
+#include "Bintree.hpp"
+#include "LeafPalette.hpp"
 
 namespace fs = std::filesystem;
 using namespace cv;
@@ -19,9 +27,34 @@ enum class ErrorMethod {
     MAD,
     MAX_PIXEL_DIFF,
     ENTROPY,
-    SSIM        // Bonus: Structural Similarity Index
+    SSIM,       // Bonus: Structural Similarity Index
+    EDGE_AWARE  // Variance plus the squared edge contrast crossing the block, both from integral images
 };
 
+enum class BuildStrategy {
+    TOP_DOWN,   // Split from the root while the error reaches the threshold
+    BOTTOM_UP   // Start from the smallest blocks and merge siblings while the merged error stays below it
+};
+
+struct MergeScratch;
+struct BuildArena;
+
+// Set from any thread to stop a running compressImage. The tree built so far stays valid
+// (unvisited blocks remain gray leaves). Shared by the threshold search's trial trees.
+class CancellationToken {
+private:
+    atomic<bool> cancelled;
+
+public:
+    CancellationToken() : cancelled(false) {}
+    void cancel() { cancelled = true; }
+    void reset() { cancelled = false; }
+    bool isCancelled() const { return cancelled.load(memory_order_relaxed); }
+};
+
+// Fraction of the image area in finished leaves, 0..1
+typedef function<void(double)> ProgressCallback;
+
 class QuadtreeNode {
 public:
     int x, y, width, height;
@@ -29,11 +62,119 @@ public:
     QuadtreeNode* children[4];
     bool isLeaf; 
 
+    QuadtreeNode() : QuadtreeNode(0, 0, 0, 0) {}
     QuadtreeNode(int x, int y, int width, int height);
     void calculateAverageColor(const Mat& image);
 };
 
+// Result of one fused walk over the tree
+struct TreeSummary {
+    int depth = 0;
+    int nodeCount = 0;
+    int leafCount = 0;
+};
+
+// Node and leaf counts per depth, kept up to date while the tree is built. Every worker
+// owns one and folds it into its parent's with merge(), so no counter is shared.
+// The squared error of every finished leaf against its avgColor is summed here as well,
+// and with GIF capture on, the worker's split events are collected here too.
+class BuildStats {
+private:
+    vector<int> nodesPerDepth;
+    vector<int> leavesPerDepth;
+    double leafSse[3] = {0, 0, 0};
+    long long leafPixels = 0;
+    vector<SplitEvent> splitEvents;     // Handed to the SplitEventLog when the build ends
+    
+    void grow(int depth) {
+        if (depth >= static_cast<int>(nodesPerDepth.size())) {
+            nodesPerDepth.resize(depth + 1, 0);
+            leavesPerDepth.resize(depth + 1, 0);
+        }
+    }
+    
+public:
+    void reset() {
+        nodesPerDepth.assign(1, 1);
+        leavesPerDepth.assign(1, 1);
+        clearDistortion();
+        splitEvents.clear();
+    }
+    
+    void clear() {
+        nodesPerDepth.clear();
+        leavesPerDepth.clear();
+        clearDistortion();
+        splitEvents.clear();
+    }
+    
+    void clearDistortion() {
+        for (int c = 0; c < 3; c++) leafSse[c] = 0;
+        leafPixels = 0;
+    }
+    
+    // A finished leaf: the moments of its block and the color it is painted with
+    void recordLeafError(const BlockMoments& moments, const Vec3b& color) {
+        for (int c = 0; c < 3; c++) leafSse[c] += moments.sseAgainst(c, color[c]);
+        leafPixels += moments.count;
+    }
+    
+    // Leaf errors summed elsewhere, e.g. by the bintree
+    void recordLeafError(const double sse[3], long long pixels) {
+        for (int c = 0; c < 3; c++) leafSse[c] += sse[c];
+        leafPixels += pixels;
+    }
+    
+    // For trees that are counted after the fact
+    void recordNode(int depth, bool isLeaf) {
+        grow(depth);
+        nodesPerDepth[depth]++;
+        if (isLeaf) leavesPerDepth[depth]++;
+    }
+    
+    // A leaf at `depth` became internal and got four leaf children. Children of zero area
+    // (halves of a 1-pixel side) cover no pixel and are left out of `children`.
+    void recordSplit(int depth, int children = 4) {
+        grow(depth + 1);
+        leavesPerDepth[depth]--;
+        nodesPerDepth[depth + 1] += children;
+        leavesPerDepth[depth + 1] += children;
+    }
+    
+    void merge(const BuildStats& other) {
+        grow(static_cast<int>(other.nodesPerDepth.size()) - 1);
+        for (size_t d = 0; d < other.nodesPerDepth.size(); d++) {
+            nodesPerDepth[d] += other.nodesPerDepth[d];
+            leavesPerDepth[d] += other.leavesPerDepth[d];
+        }
+        for (int c = 0; c < 3; c++) leafSse[c] += other.leafSse[c];
+        leafPixels += other.leafPixels;
+        splitEvents.insert(splitEvents.end(), other.splitEvents.begin(), other.splitEvents.end());
+    }
+    
+    void recordSplitEvent(const SplitEvent& event) { splitEvents.push_back(event); }
+    vector<SplitEvent>& getSplitEvents() { return splitEvents; }
+    
+    int getNodeCount(int depth) const { return depth < static_cast<int>(nodesPerDepth.size()) ? nodesPerDepth[depth] : 0; }
+    int getLeafCount(int depth) const { return depth < static_cast<int>(leavesPerDepth.size()) ? leavesPerDepth[depth] : 0; }
+    int getDepth() const {
+        int depth = static_cast<int>(nodesPerDepth.size());
+        while (depth > 0 && nodesPerDepth[depth - 1] == 0) depth--;
+        return depth;
+    }
+    
+    double getSse(int channel) const { return leafSse[channel]; }
+    long long getCoveredPixels() const { return leafPixels; }
+    // Mean over the three channels, as QualityReport::mseTotal
+    double getMse() const {
+        if (leafPixels == 0) return 0.0;
+        return (leafSse[0] + leafSse[1] + leafSse[2]) / (3.0 * leafPixels);
+    }
+};
+
 class Quadtree {
+    friend struct QuadtreeTestAccess;   // test/differential: reference metrics against the fast paths
+    
 private:
     QuadtreeNode* root;
     double threshold;
@@ -41,26 +182,74 @@ private:
     Mat sourceImage;
     ErrorMethod errorMethod;
     double targetCompressionPct; // Bonus
-    vector<Mat> gifFrames;       // Bonus
     bool visualizeGif;           // Bonus
+    SplitEventLog eventLog;      // Bonus: split decisions, replayed into GIF frames
+    ReplayOptions replayOptions;
+    int gifFrameRate;
     atomic<int> nodeCounter;    
     atomic<bool> timeoutFlag; 
+    atomic<long long> pixelsFinalized;  // Area of the finished leaves of the current build
+    const CancellationToken* cancelToken;
+    ProgressCallback progressCallback;
+    int progressIntervalMs;
+    atomic<long long> nextProgressReport;   // steady_clock ms; the thread that claims it reports
     int maxDepth; 
     bool forceLowCompression;
     double targetNodeRatio; 
     mt19937 rng;            // Random number generator
-    bool useHybridCompression;
-    double hybridCompressionTarget;
-    Rect centerRegion;
-    int centerMinBlockSize;
-    int centerMaxDepth;
-    int outerMinBlockSize;
-    int outerMaxDepth;
-    
-    void quadtreeCompress(Mat& image, QuadtreeNode* node, int depth = 0);
-    void reconstructHelper(Mat& image, QuadtreeNode* node);
-    int getTreeDepthHelper(QuadtreeNode* node);
-    int getNodeCountHelper(QuadtreeNode* node);
+    ImportanceMap importance;       // Per-pixel weights of the error, empty = uniform
+    Mat colorIntegral;              // EDGE_AWARE: integrals of the pixels, their squares and
+    Mat colorSqIntegral;            // the gradient magnitude, built once per source image
+    Mat edgeIntegral;
+    bool useBintree;                // H/V binary cuts instead of the quadtree, see Bintree
+    Bintree bintree;
+    bool solverImportance;          // Map set by the target-compression solver, dropped on the next run
+    bool useCompactStorage;
+    CompactQuadtree compactTree;    // Replaces the node pointers after compression in compact mode
+    BuildStats buildStats;
+    int totalNodes;                 // Totals of buildStats, refreshed when a build finishes
+    int totalLeaves;
+    int totalDepth;
+    bool useSampledEstimation;      // Estimate the error of very large blocks from a sample (opt-in)
+    int samplingMinPixels;
+    int samplingCount;
+    double samplingConfidence;      // z-score a sampled estimate must clear the threshold by
+    Point2d samplingOffset;         // Fixed shift of the Halton points, so sampled builds are reproducible
+    atomic<int> sampledSplits;
+    BuildStrategy buildStrategy;
+    bool numaAware;                 // Root quadrants on pinned workers with node-local copies
+    double targetPsnr;              // Quality floor in dB, 0 = off
+    double targetSsim;              // Quality floor as mean block SSIM, 0 = off
+    int paletteSize;                // Leaf colors quantized to this many entries, 0 = off
+    bool lossless;                  // Leaves only on exactly uniform blocks, down to single pixels
+    int outputScale;                // sourceImage was decoded at 1/outputScale of outputSize
+    Size outputSize;
+    LeafPalette palette;
+    BuildArena* arena;              // Worker scratch: pooled nodes, no source copy, serial build
+    
+    // known: moments of the node's block gathered by the parent's scan, if any
+    void quadtreeCompress(Mat& image, QuadtreeNode* node, BuildStats& stats, int depth = 0,
+                          const BlockMoments* known = nullptr);
+    void compressNode(Mat& image, QuadtreeNode* node, int depth, BuildStats& stats, const BlockMoments* known);
+    // Returns the moments the color came from, for the leaf error in BuildStats
+    BlockMoments setLeafColor(QuadtreeNode* node, const Mat& image, const BlockMoments* known);
+    
+    // Bottom-up strategy
+    void buildBottomUp();
+    QuadtreeNode* mergeBuild(const Mat& image, int x, int y, int width, int height, int depth,
+                             MergeScratch& scratch, BlockMoments& moments, int* histogram);
+    bool mergedErrorReaches(const Mat& block, const Rect& rect, const BlockMoments& moments, const int* histogram);
+    void finishMergedTree();
+    bool useNumaPartitioning() const;
+    void translateSubtree(QuadtreeNode* node, int dx, int dy);
+    void refreshTotals();
+    void buildBintree();
+    void applyPalette();
+    void losslessCompress(const Mat& image, QuadtreeNode* node, int depth, BuildStats& stats);
+    bool isCancelled() const { return cancelToken && cancelToken->isCancelled(); }
+    bool shouldStop() const { return timeoutFlag || isCancelled(); }
+    void reportProgress(bool force = false);
+    QuadtreeNode* newNode(int x, int y, int width, int height);
     void deleteTree(QuadtreeNode* node);
     
     // Error measurement methods
@@ -69,34 +258,125 @@ private:
     double calculateMaxPixelDiff(const Mat& block);
     double calculateEntropy(const Mat& block);
     double calculateSSIM(const Mat& block, const Mat& avgBlock); // Bonus: SSIM calculation
+    double uniformBlockSSIM(const Mat& block);  // calculateSSIM against the mean-color block, without building it
     double calculateError(const Mat& block, const Mat& avgBlock = Mat());
+    
+    // Bounded evaluation: only answers error >= limit, stopping as soon as a bound settles it
+    bool errorReachesThreshold(const Mat& block, double limit, int splitX, int splitY, const BlockMoments* known,
+                               BlockMoments& total, BlockMoments childMoments[4], bool& childMomentsValid);
+    double momentLowerBound(const BlockMoments& partial, int blockPixels, bool smallBlock);
+    double ssimFromMoments(const BlockMoments& moments, bool smallBlock);
+    bool boundedMAD(const Mat& block, const BlockMoments& total, double limit);
+    bool boundedEntropy(const Mat& block, double limit);
+    bool sampledErrorReaches(const Mat& block, double limit, bool smallBlock);
+    bool weightedErrorReaches(const Mat& block, const Rect& rect, double limit, double weight, int splitX, int splitY,
+                              const BlockMoments* known, BlockMoments& total, BlockMoments childMoments[4],
+                              bool& childMomentsValid);
+    double blockWeight(const Rect& rect) const;
+    void gatherLeafMoments(const Mat& block, int splitX, int splitY, const BlockMoments* known,
+                           BlockMoments& total, BlockMoments childMoments[4]);
+    void prepareEdgeIntegrals();
+    double edgeAwareError(const Rect& rect) const;
+    bool edgeErrorReaches(const Mat& block, const Rect& rect, double limit, int splitX, int splitY,
+                          const BlockMoments* known, BlockMoments& total, BlockMoments childMoments[4],
+                          bool& childMomentsValid);
     string getErrorMethodName(ErrorMethod method);
     
     // Bonus: Dynamic threshold adjustment
     void adjustThresholdForTargetCompression(const Mat& image);
+    // Quality floor: splits the leaf that gains the most until the floor is met
+    void buildToQuality();
+    bool hasQualityTarget() const { return targetPsnr > 0.0 || targetSsim > 0.0; }
     // Bonus: GIF visualization
-    void captureFrameForGif(const Mat& currentImage);
-    void drawQuadtreeVisualization(Mat& image, QuadtreeNode* node, int depth);
-    Mat getSafeRoi(const Mat& image, int x, int y, int width, int height);
+    void recordSplitEvent(const Mat& image, QuadtreeNode* node, int depth, BuildStats& stats);
+    bool streamAnimation(AnimationWriter& writer, const string& outputPath, const string& formatName);
     
 public:
+    // With an arena the image is shared instead of copied and must outlive the tree; nodes
+    // and scratch buffers come from the arena and the build stays on the calling thread
     Quadtree(const Mat& image, double threshold, int minBlockSize, 
              ErrorMethod method = ErrorMethod::VARIANCE, 
              double targetCompressionPct = 0.0,
-             bool visualizeGif = false);
+             bool visualizeGif = false,
+             BuildArena* arena = nullptr);
     ~Quadtree();
     
     void compressImage();
-    void reconstructImage(Mat& image);
-    int getTreeDepth();
-    int getNodeCount();
+    // Just the tree build with the current threshold: no threshold search, timeout or logging
+    void buildTree();
+    bool saveContainer(const string& outputPath);
+    void reconstructImage(Mat& image, TreeSummary* summary = nullptr);
+    TreeSummary summarizeTree(Mat* reconstruction = nullptr);
+    int getTreeDepth() const { return totalDepth; }
+    int getNodeCount() const { return totalNodes; }
     int countLeafNodes(QuadtreeNode* node);
+    int getLeafCount() const { return totalLeaves; }
+    // Live counters, safe to read from another thread while compressImage runs. Builds
+    // that only know their leaves at the end (bottom-up, bintree, quality) jump to 1 then.
+    // The threshold search's trial trees are not counted: progress stays 0 until the final build.
+    double getProgress() const;
+    int getNodesProcessed() const { return nodeCounter; }
+    // Called from whichever build thread finishes a leaf, at most once per intervalMs, and
+    // once more when compressImage returns (1.0 unless cancelled). Keep it short and thread-safe.
+    void setProgressCallback(ProgressCallback callback, int intervalMs = 100) {
+        progressCallback = callback;
+        progressIntervalMs = std::max(0, intervalMs);
+    }
+    // Checked cooperatively at every node; the token must outlive compressImage. The
+    // bintree and bottom-up builds only check it before they start.
+    void setCancellationToken(const CancellationToken* token) { cancelToken = token; }
+    bool wasCancelled() const { return isCancelled(); }
+    const BuildStats& getBuildStats() const { return buildStats; }
+    // Exact PSNR of the tree against the source, from the leaf errors summed during the build
+    double getBuildPsnr() const;
+    bool hasCompleteDistortion() const;     // false when a timeout left blocks unvisited
+    void setCompactStorage(bool enabled) { useCompactStorage = enabled; }
+    void setBuildStrategy(BuildStrategy strategy) { buildStrategy = strategy; }
+    void setNumaAware(bool enabled) { numaAware = enabled; }
+    // Per-pixel importance (saliency, face boxes, ...), any single-channel map; an empty Mat
+    // turns it off. High weights make blocks split earlier, low weights let them merge.
+    void setImportanceMap(const Mat& weights);
+    // Bintree mode: variance criterion only; quality targets, importance map, GIF and compact
+    // storage do not apply. Reconstruction, statistics and .qtc output follow the bintree.
+    // Bintree cuts are chosen by variance only, so the error method becomes VARIANCE and the
+    // threshold (and the solver's search range) is read on the variance scale
+    void setBintreeMode(bool enabled) {
+        useBintree = enabled;
+        if (enabled) errorMethod = ErrorMethod::VARIANCE;
+    }
+    bool isBintree() const { return useBintree && !bintree.empty(); }
+    const Bintree& getBintree() const { return bintree; }
+    // Coarsest tree meeting a PSNR or SSIM floor; threshold, target percentage and timeout are
+    // not used then. The SSIM floor is mean block SSIM (BlockMoments::ssimAgainst, area weighted),
+    // as evaluateLeafQuality reports it, not the 11x11 Gaussian SSIM of evaluateQuality.
+    void setTargetPsnr(double psnr) { targetPsnr = std::max(0.0, psnr); targetSsim = 0.0; }
+    void setTargetSsim(double ssim) { targetSsim = std::min(1.0, std::max(0.0, ssim)); targetPsnr = 0.0; }
+    // Lossless: threshold, block size, depth, timeout, target and bintree settings are ignored;
+    // .qtc output run-length codes neighbouring equal leaves
+    void setLossless(bool enabled) { lossless = enabled; }
+    bool isLossless() const { return lossless; }
+    // Source decoded at reduced scale: the tree and reconstructImage stay at that scale,
+    // .qtc output records the full geometry (SCAL chunk, see expandScaledImage)
+    void setOutputGeometry(int scale, const Size& size) { outputScale = std::max(1, scale); outputSize = size; }
+    // Post-build palette over the leaf colors (area weighted); .qtc output then stores indices
+    void setPaletteSize(int colors) { paletteSize = std::max(0, std::min(colors, LeafPalette::MAX_COLORS)); }
+    const LeafPalette& getPalette() const { return palette; }
+    // Off by default: exact builds. Sampled splits depend only on the image and these settings.
+    void setSampledEstimation(bool enabled, int minBlockPixels = 512 * 512, int samples = 1024, double confidence = 3.0);
+    bool isCompact() const { return root == nullptr && !compactTree.empty(); }
+    const CompactQuadtree& getCompactTree() const { return compactTree; }
     double calculateCompressionPercentage(const string& originalImagePath, const string& compressedImagePath);
     double getThreshold() const { return threshold; }
-    QuadtreeNode* getRoot() const { return root; }
+    QuadtreeNode* getRoot() const { return root; }  // nullptr in compact mode
     
     // Bonus: Save GIF animation
     bool saveGifAnimation(const string& outputPath);
+    bool saveApngAnimation(const string& outputPath);
+    bool saveWebpAnimation(const string& outputPath);
+    bool saveAnimation(const string& outputPath);   // Format from extension: .gif, .png/.apng, .webp
+    void setVisualizationOptions(int frameCount, int frameRate, Size frameSize = Size(640, 480));
+    const SplitEventLog& getEventLog() const { return eventLog; }
+    bool saveEventLog(const string& outputPath) const { return eventLog.save(outputPath); }
 };
 
 string getErrorMethodName(ErrorMethod method);
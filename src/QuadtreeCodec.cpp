@@ -0,0 +1,526 @@
+#include "QuadtreeCodec.hpp"
+#include "Quadtree.hpp"
+#include "CompactQuadtree.hpp"
+#include "Bintree.hpp"
+#include <cstring>
+
+static const char CONTAINER_MAGIC[4] = {'Q', 'T', 'C', '1'};
+static const uint32_t MAX_CHUNK_BYTES = 1u << 30;
+
+static void putUint16LE(vector<uchar>& buffer, uint16_t value) {
+    buffer.push_back(static_cast<uchar>(value));
+    buffer.push_back(static_cast<uchar>(value >> 8));
+}
+
+static void putUint32LE(vector<uchar>& buffer, uint32_t value) {
+    putUint16LE(buffer, static_cast<uint16_t>(value));
+    putUint16LE(buffer, static_cast<uint16_t>(value >> 16));
+}
+
+static uint16_t readUint16LE(const uchar* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t readUint32LE(const uchar* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+Rect ContainerHeader::tileRect(int index) const {
+    if (tileSize == 0) {
+        return Rect(0, 0, static_cast<int>(width), static_cast<int>(height));
+    }
+
+    int column = index % tileColumns();
+    int row = index / tileColumns();
+    int x = column * tileSize;
+    int y = row * tileSize;
+    return Rect(x, y, std::min<int>(tileSize, static_cast<int>(width) - x),
+                std::min<int>(tileSize, static_cast<int>(height) - y));
+}
+
+bool QuadtreeEncoder::writeChunk(const char type[4], const vector<uchar>& payload) {
+    vector<uchar> length;
+    putUint32LE(length, static_cast<uint32_t>(payload.size()));
+
+    out.write(type, 4);
+    out.write(reinterpret_cast<const char*>(length.data()), length.size());
+    if (!payload.empty()) {
+        out.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    }
+    return out.good();
+}
+
+void QuadtreeEncoder::appendLeafColor(vector<uchar>& colors, const Vec3b& color) const {
+    if (palette.empty()) {
+        colors.push_back(color[0]);
+        colors.push_back(color[1]);
+        colors.push_back(color[2]);
+    } else if (palette.bytesPerIndex() == 1) {
+        colors.push_back(static_cast<uchar>(palette.nearest(color)));
+    } else {
+        putUint16LE(colors, static_cast<uint16_t>(palette.nearest(color)));
+    }
+}
+
+bool QuadtreeEncoder::writeColors(const vector<uchar>& colors) {
+    if (!(header.flags & CONTAINER_FLAG_RUNS)) {
+        return writeChunk(colorChunkType(), colors);
+    }
+    
+    const size_t recordBytes = palette.empty() ? 3 : palette.bytesPerIndex();
+    vector<uchar> runs;
+    size_t i = 0;
+    while (i < colors.size()) {
+        size_t end = i + recordBytes;
+        while (end + recordBytes <= colors.size() && memcmp(&colors[end], &colors[i], recordBytes) == 0) {
+            end += recordBytes;
+        }
+        
+        for (uint32_t length = static_cast<uint32_t>((end - i) / recordBytes); ; length >>= 7) {
+            if (length < 0x80) {
+                runs.push_back(static_cast<uchar>(length));
+                break;
+            }
+            runs.push_back(static_cast<uchar>((length & 0x7F) | 0x80));
+        }
+        runs.insert(runs.end(), colors.begin() + i, colors.begin() + i + recordBytes);
+        i = end;
+    }
+    return writeChunk(colorChunkType(), runs);
+}
+
+bool QuadtreeEncoder::open(const string& path, const ContainerHeader& containerHeader) {
+    header = containerHeader;
+    tilesWritten = 0;
+    palette.clear();
+
+    out.open(path, ios::binary | ios::trunc);
+    if (!out.is_open()) return false;
+
+    vector<uchar> bytes(CONTAINER_MAGIC, CONTAINER_MAGIC + 4);
+    putUint32LE(bytes, header.width);
+    putUint32LE(bytes, header.height);
+    putUint16LE(bytes, header.tileSize);
+    bytes.push_back(static_cast<uchar>(header.kind));
+    bytes.push_back(header.flags);
+
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return out.good();
+}
+
+bool QuadtreeEncoder::writePalette(const LeafPalette& leafPalette) {
+    if (!out.is_open() || tilesWritten > 0 || leafPalette.empty()) return false;
+    if (!(header.flags & CONTAINER_FLAG_PALETTE)) return false;
+
+    vector<uchar> payload;
+    putUint16LE(payload, static_cast<uint16_t>(leafPalette.size()));
+    for (const Vec3b& color : leafPalette.getColors()) {
+        payload.push_back(color[0]);
+        payload.push_back(color[1]);
+        payload.push_back(color[2]);
+    }
+
+    if (!writeChunk("PLTE", payload)) return false;
+    palette = leafPalette;
+    return true;
+}
+
+bool QuadtreeEncoder::writeScale(int scale, const Size& outputSize) {
+    if (!out.is_open() || tilesWritten > 0 || scale < 1 || scale > 0xFFFF) return false;
+
+    vector<uchar> payload;
+    putUint16LE(payload, static_cast<uint16_t>(scale));
+    putUint32LE(payload, static_cast<uint32_t>(outputSize.width));
+    putUint32LE(payload, static_cast<uint32_t>(outputSize.height));
+    return writeChunk("SCAL", payload);
+}
+
+bool QuadtreeEncoder::writeTree(const QuadtreeNode* root) {
+    if (!out.is_open() || tilesWritten >= header.tileCount()) return false;
+
+    vector<uchar> structure(4, 0);
+    vector<uchar> colors;
+    uint32_t nodeCount = 0;
+
+    // Pre-order; a missing child of an internal node is written as a gray leaf. Leaves
+    // without area (halves of a 1-pixel side) repeat the previous color to keep runs intact.
+    Vec3b lastColor(128, 128, 128);
+    vector<const QuadtreeNode*> stack(1, root);
+    while (!stack.empty()) {
+        const QuadtreeNode* node = stack.back();
+        stack.pop_back();
+
+        if ((nodeCount & 7) == 0) structure.push_back(0);
+
+        if (node && !node->isLeaf) {
+            structure.back() |= static_cast<uchar>(1 << (nodeCount & 7));
+            for (int i = 3; i >= 0; i--) {
+                stack.push_back(node->children[i]);
+            }
+        } else {
+            Vec3b color = node ? node->avgColor : Vec3b(128, 128, 128);
+            if (node && (node->width <= 0 || node->height <= 0)) color = lastColor;
+            appendLeafColor(colors, color);
+            lastColor = color;
+        }
+        nodeCount++;
+    }
+
+    structure[0] = static_cast<uchar>(nodeCount);
+    structure[1] = static_cast<uchar>(nodeCount >> 8);
+    structure[2] = static_cast<uchar>(nodeCount >> 16);
+    structure[3] = static_cast<uchar>(nodeCount >> 24);
+
+    bool ok = writeChunk("TREE", structure) && writeColors(colors);
+    if (ok) tilesWritten++;
+    return ok;
+}
+
+bool QuadtreeEncoder::writeBintree(const Bintree& tree) {
+    if (!out.is_open() || tilesWritten >= header.tileCount() || tree.empty()) return false;
+
+    const vector<BintreeNode>& nodes = tree.getNodes();
+    vector<uchar> structure;
+    vector<uchar> colors;
+    putUint32LE(structure, static_cast<uint32_t>(nodes.size()));
+    uint32_t nodeCount = 0;
+
+    // Pre-order, four nodes per byte
+    vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        const BintreeNode& node = nodes[stack.back()];
+        stack.pop_back();
+
+        if ((nodeCount & 3) == 0) structure.push_back(0);
+        structure.back() |= static_cast<uchar>(static_cast<uint8_t>(node.split) << (2 * (nodeCount & 3)));
+
+        if (node.firstChild >= 0) {
+            stack.push_back(node.firstChild + 1);
+            stack.push_back(node.firstChild);
+        } else {
+            appendLeafColor(colors, node.avgColor);
+        }
+        nodeCount++;
+    }
+
+    bool ok = writeChunk("BTRE", structure) && writeColors(colors);
+    if (ok) tilesWritten++;
+    return ok;
+}
+
+bool QuadtreeEncoder::close() {
+    if (!out.is_open()) return false;
+
+    bool ok = tilesWritten == header.tileCount();
+    ok = writeChunk("QEND", vector<uchar>()) && ok;
+    out.close();
+    return ok;
+}
+
+bool QuadtreeDecoder::open(const string& path) {
+    in.open(path, ios::binary);
+    if (!in.is_open()) return false;
+
+    uchar bytes[16];
+    in.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+    if (!in || memcmp(bytes, CONTAINER_MAGIC, 4) != 0) return false;
+
+    header.width = readUint32LE(bytes + 4);
+    header.height = readUint32LE(bytes + 8);
+    header.tileSize = readUint16LE(bytes + 12);
+    header.kind = static_cast<ContainerKind>(bytes[14]);
+    header.flags = bytes[15];
+
+    if (header.width == 0 || header.height == 0 ||
+        header.width > MAX_CONTAINER_DIMENSION || header.height > MAX_CONTAINER_DIMENSION) {
+        return false;
+    }
+
+    // Every tile has a tree and a color chunk, 8 header bytes each, so the rest of the file
+    // bounds the tile count before anything is allocated for them
+    uint64_t tiles = 1;
+    if (header.tileSize > 0) {
+        tiles = static_cast<uint64_t>((header.width + header.tileSize - 1) / header.tileSize) *
+                ((header.height + header.tileSize - 1) / header.tileSize);
+    }
+    streamoff start = in.tellg();
+    in.seekg(0, ios::end);
+    streamoff end = in.tellg();
+    in.seekg(start);
+    return in && end >= start && static_cast<uint64_t>(end - start) >= tiles * 16;
+}
+
+bool QuadtreeDecoder::readChunk(ContainerChunk& chunk) {
+    uchar bytes[8];
+    in.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+    if (!in) return false;
+
+    chunk.type.assign(reinterpret_cast<const char*>(bytes), 4);
+    uint32_t length = readUint32LE(bytes + 4);
+    if (chunk.type == "QEND" || length > MAX_CHUNK_BYTES) return false;
+
+    chunk.payload.resize(length);
+    if (length > 0) {
+        in.read(reinterpret_cast<char*>(chunk.payload.data()), length);
+    }
+    return static_cast<bool>(in);
+}
+
+// Pre-order walk shared by TREE (1 bit per node) and BTRE (2 bits per node). Below
+// maxDepth a subtree gets one accumulator and is painted once with the area-weighted
+// mean of its leaves.
+struct PaintEntry {
+    Rect rect;
+    int depth;
+    int slot;       // Accumulator of the LOD ancestor, -1 = paint directly
+};
+
+struct LodSlot {
+    Rect rect;
+    double sum[3];
+    double area;
+};
+
+static bool paintPreOrder(const vector<uchar>& tree, const vector<uchar>& colors, Mat& image, const Rect& region,
+                          bool bintree, int maxDepth, ContainerStats* stats) {
+    if (tree.size() < 4) return false;
+
+    uint32_t nodeCount = readUint32LE(tree.data());
+    const size_t bitsPerNode = bintree ? 2 : 1;
+    if (tree.size() < 4 + (static_cast<size_t>(nodeCount) * bitsPerNode + 7) / 8) return false;
+
+    const uchar* bits = tree.data() + 4;
+    const Rect bounds(0, 0, image.cols, image.rows);
+    size_t leafIndex = 0;
+    vector<LodSlot> slots;
+
+    vector<PaintEntry> stack(1, PaintEntry{region, 0, -1});
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        if (stack.empty()) return false;
+        PaintEntry entry = stack.back();
+        stack.pop_back();
+
+        int split = bintree ? (bits[i >> 2] >> (2 * (i & 3))) & 3 : (bits[i >> 3] >> (i & 7)) & 1;
+        if (bintree && split == 3) return false;
+        if (stats) stats->countNode(entry.depth, split == 0);
+
+        if (split != 0) {
+            int slot = entry.slot;
+            if (slot < 0 && maxDepth >= 0 && entry.depth >= maxDepth) {
+                slots.push_back(LodSlot{entry.rect, {0, 0, 0}, 0});
+                slot = static_cast<int>(slots.size()) - 1;
+            }
+
+            Rect children[4];
+            int childCount = 4;
+            if (bintree) {
+                Bintree::childRects(entry.rect, static_cast<BintreeSplit>(split), children);
+                childCount = 2;
+            } else {
+                CompactQuadtree::childRects(entry.rect, children);
+            }
+            for (int k = childCount - 1; k >= 0; k--) {
+                stack.push_back(PaintEntry{children[k], entry.depth + 1, slot});
+            }
+            continue;
+        }
+
+        if (3 * leafIndex + 3 > colors.size()) return false;
+        const uchar* c = &colors[3 * leafIndex++];
+
+        Rect area = entry.rect & bounds;
+        if (area.width <= 0 || area.height <= 0) continue;
+
+        if (entry.slot >= 0) {
+            LodSlot& slot = slots[entry.slot];
+            double a = static_cast<double>(area.area());
+            for (int k = 0; k < 3; k++) slot.sum[k] += c[k] * a;
+            slot.area += a;
+        } else {
+            image(area).setTo(Scalar(c[0], c[1], c[2]));
+        }
+    }
+
+    for (const LodSlot& slot : slots) {
+        Rect area = slot.rect & bounds;
+        if (slot.area <= 0 || area.width <= 0 || area.height <= 0) continue;
+        image(area).setTo(Scalar(cvRound(slot.sum[0] / slot.area), cvRound(slot.sum[1] / slot.area),
+                                 cvRound(slot.sum[2] / slot.area)));
+    }
+
+    return stack.empty();
+}
+
+bool paintTree(const vector<uchar>& tree, const vector<uchar>& colors, Mat& image, const Rect& region,
+               int maxDepth, ContainerStats* stats) {
+    return paintPreOrder(tree, colors, image, region, false, maxDepth, stats);
+}
+
+bool paintBintree(const vector<uchar>& tree, const vector<uchar>& colors, Mat& image, const Rect& region,
+                  int maxDepth, ContainerStats* stats) {
+    return paintPreOrder(tree, colors, image, region, true, maxDepth, stats);
+}
+
+bool expandPaletteIndices(const vector<uchar>& indices, const vector<uchar>& palette, vector<uchar>& colors) {
+    if (palette.size() < 2) return false;
+
+    size_t count = readUint16LE(palette.data());
+    if (count == 0 || palette.size() < 2 + 3 * count) return false;
+    const uchar* entries = palette.data() + 2;
+    const size_t width = count <= 256 ? 1 : 2;
+    if (indices.size() % width != 0) return false;
+
+    colors.resize(indices.size() / width * 3);
+    for (size_t i = 0, out = 0; i < indices.size(); i += width, out += 3) {
+        size_t index = width == 1 ? indices[i] : readUint16LE(&indices[i]);
+        if (index >= count) return false;
+        memcpy(&colors[out], entries + 3 * index, 3);
+    }
+    return true;
+}
+
+bool expandScaledImage(const Mat& image, int scale, const Size& outputSize, Mat& output) {
+    // A geometry that does not cover image is a bug upstream, not something to stretch over
+    if (scale < 1 || outputSize.width <= 0 || outputSize.height <= 0 ||
+        (outputSize.width + scale - 1) / scale != image.cols || (outputSize.height + scale - 1) / scale != image.rows) {
+        return false;
+    }
+    if (scale == 1) {
+        output = image.clone();
+        return true;
+    }
+
+    Mat result(outputSize, CV_8UC3);
+    parallel_for_(Range(0, outputSize.height), [&](const Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const Vec3b* src = image.ptr<Vec3b>(y / scale);
+            Vec3b* dst = result.ptr<Vec3b>(y);
+            for (int x = 0; x < outputSize.width; x++) {
+                dst[x] = src[x / scale];
+            }
+        }
+    });
+    output = result;
+    return true;
+}
+
+bool expandColorRuns(const vector<uchar>& runs, size_t recordBytes, size_t maxRecords, vector<uchar>& records) {
+    records.clear();
+    size_t i = 0;
+    while (i < runs.size()) {
+        uint64_t length = 0;
+        int shift = 0;
+        while (true) {
+            if (i >= runs.size() || shift > 28) return false;
+            uchar byte = runs[i++];
+            length |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+            shift += 7;
+        }
+        
+        if (length == 0 || i + recordBytes > runs.size()) return false;
+        if (records.size() / recordBytes + length > maxRecords) return false;
+        for (uint64_t r = 0; r < length; r++) {
+            records.insert(records.end(), runs.begin() + i, runs.begin() + i + recordBytes);
+        }
+        i += recordBytes;
+    }
+    return true;
+}
+
+void ContainerStats::countNode(int depth, bool isLeaf) {
+    if (depth >= static_cast<int>(nodesPerDepth.size())) {
+        nodesPerDepth.resize(depth + 1, 0);
+        leavesPerDepth.resize(depth + 1, 0);
+    }
+    nodesPerDepth[depth]++;
+    if (isLeaf) leavesPerDepth[depth]++;
+}
+
+static bool decodeContainerChunks(const string& path, Mat& image, int maxDepth, ContainerStats* stats) {
+    QuadtreeDecoder decoder;
+    if (!decoder.open(path)) return false;
+    if (stats) {
+        *stats = ContainerStats();
+        stats->header = decoder.getHeader();
+    }
+
+    ContainerKind kind = decoder.getHeader().kind;
+    if (kind != ContainerKind::QUADTREE && kind != ContainerKind::BINTREE) return false;
+    const char* treeType = kind == ContainerKind::BINTREE ? "BTRE" : "TREE";
+
+    const ContainerHeader& header = decoder.getHeader();
+    image = Mat(header.height, header.width, CV_8UC3, Scalar(128, 128, 128));
+
+    ContainerChunk chunk;
+    vector<uchar> tree;
+    vector<uchar> palette;
+    vector<uchar> colors;
+    vector<uchar> records;
+    int tileIndex = 0;
+    int scale = 1;
+    Size outputSize = image.size();
+
+    while (decoder.readChunk(chunk)) {
+        if (stats) stats->chunkBytes[chunk.type] += 8 + chunk.payload.size();
+        
+        if (chunk.type == treeType) {
+            tree.swap(chunk.payload);
+        } else if (chunk.type == "PLTE") {
+            palette.swap(chunk.payload);
+        } else if (chunk.type == "SCAL") {
+            if (chunk.payload.size() < 10) return false;
+            scale = readUint16LE(chunk.payload.data());
+            outputSize = Size(static_cast<int>(readUint32LE(chunk.payload.data() + 2)),
+                              static_cast<int>(readUint32LE(chunk.payload.data() + 6)));
+            if (scale < 1 || outputSize.width <= 0 || outputSize.height <= 0 ||
+                static_cast<uint32_t>(outputSize.width) > MAX_CONTAINER_DIMENSION ||
+                static_cast<uint32_t>(outputSize.height) > MAX_CONTAINER_DIMENSION ||
+                static_cast<uint64_t>(header.width) * scale < static_cast<uint64_t>(outputSize.width) ||
+                static_cast<uint64_t>(header.height) * scale < static_cast<uint64_t>(outputSize.height) ||
+                static_cast<uint64_t>(header.width - 1) * scale >= static_cast<uint64_t>(outputSize.width) ||
+                static_cast<uint64_t>(header.height - 1) * scale >= static_cast<uint64_t>(outputSize.height)) {
+                return false;
+            }
+        } else if (chunk.type == "COLR" || chunk.type == "CIDX") {
+            if (tileIndex >= header.tileCount()) return false;
+            if (header.flags & CONTAINER_FLAG_RUNS) {
+                size_t recordBytes = 3;
+                if (chunk.type == "CIDX") {
+                    if (palette.size() < 2) return false;
+                    recordBytes = readUint16LE(palette.data()) <= 256 ? 1 : 2;
+                }
+                size_t maxRecords = tree.size() >= 4 ? readUint32LE(tree.data()) : 0;
+                if (!expandColorRuns(chunk.payload, recordBytes, maxRecords, records)) return false;
+                chunk.payload.swap(records);
+            }
+            if (chunk.type == "CIDX") {
+                if (!expandPaletteIndices(chunk.payload, palette, colors)) return false;
+            } else {
+                colors.swap(chunk.payload);
+            }
+            bool painted = kind == ContainerKind::BINTREE
+                ? paintBintree(tree, colors, image, header.tileRect(tileIndex), maxDepth, stats)
+                : paintTree(tree, colors, image, header.tileRect(tileIndex), maxDepth, stats);
+            if (!painted) return false;
+            tileIndex++;
+            if (stats) stats->tiles = tileIndex;
+        }
+    }
+
+    if (tileIndex != header.tileCount()) return false;
+    if (scale > 1 || outputSize != image.size()) {
+        return expandScaledImage(image, scale, outputSize, image);
+    }
+    return true;
+}
+
+bool decodeContainer(const string& path, Mat& image, int maxDepth, ContainerStats* stats) {
+    // A header within the limits can still ask for more memory than there is
+    try {
+        return decodeContainerChunks(path, image, maxDepth, stats);
+    } catch (const std::exception&) {
+        image.release();
+        return false;
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef QUADTREE_CODEC_HPP
+#define QUADTREE_CODEC_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <map>
+#include "LeafPalette.hpp"
+
+using namespace cv;
+using namespace std;
+
+class QuadtreeNode;
+class Bintree;
+
+// Native container (.qtc). A fixed header is followed by chunks (4-byte type, uint32
+// length, payload) up to QEND, so readers can skip chunk types they do not know.
+// Geometry is never stored: it follows from the image size, the tile size and the
+// halving rule, as in CompactQuadtree.
+//
+//   header  "QTC1" | uint32 width | uint32 height | uint16 tileSize | uint8 kind | uint8 flags
+//   TREE    uint32 node count | one bit per node in pre-order, 1 = internal
+//   COLR    one BGR triple per leaf, same order
+//   BTRE    (kind BINTREE, instead of TREE) uint32 node count | two bits per node in
+//           pre-order: 0 = leaf, 1 = horizontal cut, 2 = vertical cut, see Bintree
+//   PLTE    (flag PALETTE, once before the first tile) uint16 count | BGR triples
+//   CIDX    (flag PALETTE, instead of COLR) one palette index per leaf, uint8 when the
+//           palette has at most 256 colors, uint16 otherwise
+//   SCAL    (optional, before the first tile) uint16 scale | uint32 width | uint32 height:
+//           the tree was built at 1/scale; every tree pixel stands for a scale x scale
+//           block of the width x height output, cropped at the right and bottom edges
+//   runs    (flag RUNS) COLR/CIDX hold (LEB128 run length, one record) pairs instead of
+//           one record per leaf, so neighbouring equal leaves cost a few bytes in total
+//
+// tileSize 0 means a single tree over the whole image. Otherwise the image is cut into
+// tileSize x tileSize tiles and every tile, in raster order, has its own TREE and COLR.
+enum class ContainerKind : uint8_t {
+    QUADTREE = 0,
+    BINTREE = 1
+};
+
+static const uint8_t CONTAINER_FLAG_PALETTE = 1;
+static const uint8_t CONTAINER_FLAG_RUNS = 2;
+// Largest width or height a decoder accepts, the same cap ImageLoader puts on input images
+static const uint32_t MAX_CONTAINER_DIMENSION = 1 << 20;
+
+struct ContainerHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint16_t tileSize = 0;
+    ContainerKind kind = ContainerKind::QUADTREE;
+    uint8_t flags = 0;
+
+    int tileColumns() const { return tileSize == 0 ? 1 : static_cast<int>((width + tileSize - 1) / tileSize); }
+    int tileRows() const { return tileSize == 0 ? 1 : static_cast<int>((height + tileSize - 1) / tileSize); }
+    int tileCount() const { return tileColumns() * tileRows(); }
+    Rect tileRect(int index) const;
+};
+
+struct ContainerChunk {
+    string type;
+    vector<uchar> payload;
+};
+
+class QuadtreeEncoder {
+private:
+    ofstream out;
+    ContainerHeader header;
+    int tilesWritten;
+    LeafPalette palette;
+
+    bool writeChunk(const char type[4], const vector<uchar>& payload);
+    void appendLeafColor(vector<uchar>& colors, const Vec3b& color) const;
+    bool writeColors(const vector<uchar>& colors);
+    const char* colorChunkType() const { return palette.empty() ? "COLR" : "CIDX"; }
+
+public:
+    QuadtreeEncoder() : tilesWritten(0) {}
+    ~QuadtreeEncoder() { if (out.is_open()) close(); }
+
+    bool open(const string& path, const ContainerHeader& header);
+    // Writes PLTE; leaves of the following tiles are stored as CIDX indices into it
+    bool writePalette(const LeafPalette& leafPalette);
+    bool writeScale(int scale, const Size& outputSize);
+    // Next tile (or the whole image when tileSize is 0), root at the tile origin
+    bool writeTree(const QuadtreeNode* root);
+    bool writeBintree(const Bintree& tree);
+    bool close();
+
+    const ContainerHeader& getHeader() const { return header; }
+    int getTilesWritten() const { return tilesWritten; }
+};
+
+class QuadtreeDecoder {
+private:
+    ifstream in;
+    ContainerHeader header;
+
+public:
+    // False on a bad magic, dimensions over MAX_CONTAINER_DIMENSION, or a file too short
+    // to hold the chunk headers of every tile
+    bool open(const string& path);
+    const ContainerHeader& getHeader() const { return header; }
+    // False at QEND, at end of file or on a damaged chunk
+    bool readChunk(ContainerChunk& chunk);
+};
+
+// What a decode saw: node and leaf counts per depth (summed over tiles) and the bytes
+// of every chunk type, chunk header included
+struct ContainerStats {
+    ContainerHeader header;
+    vector<int> nodesPerDepth;
+    vector<int> leavesPerDepth;
+    map<string, size_t> chunkBytes;
+    int tiles = 0;
+
+    void countNode(int depth, bool isLeaf);
+};
+
+// Paints one TREE/COLR pair into region of image. With maxDepth >= 0 (level of detail)
+// every subtree below that depth is painted as one block, the area-weighted mean of its leaves.
+bool paintTree(const vector<uchar>& tree, const vector<uchar>& colors, Mat& image, const Rect& region,
+               int maxDepth = -1, ContainerStats* stats = nullptr);
+// Same for one BTRE/COLR pair
+bool paintBintree(const vector<uchar>& tree, const vector<uchar>& colors, Mat& image, const Rect& region,
+                  int maxDepth = -1, ContainerStats* stats = nullptr);
+// CIDX payload back to COLR triples using the PLTE payload
+bool expandPaletteIndices(const vector<uchar>& indices, const vector<uchar>& palette, vector<uchar>& colors);
+// Tree-scale image to the output geometry: pixel (x, y) of output is pixel (x / scale,
+// y / scale) of image, so leaf edges land exactly on multiples of scale. False, output
+// untouched, unless ceil(outputSize / scale) == image.size().
+bool expandScaledImage(const Mat& image, int scale, const Size& outputSize, Mat& output);
+// One record per leaf from a RUNS payload, at most maxRecords of them
+bool expandColorRuns(const vector<uchar>& runs, size_t recordBytes, size_t maxRecords, vector<uchar>& records);
+// False on any damaged or implausible container; never throws
+bool decodeContainer(const string& path, Mat& image, int maxDepth = -1, ContainerStats* stats = nullptr);
+
+#endif
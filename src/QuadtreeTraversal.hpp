@@ -0,0 +1,150 @@
+#ifndef QUADTREE_TRAVERSAL_HPP
+#define QUADTREE_TRAVERSAL_HPP
+
+#include "Quadtree.hpp"
+#include <future>
+#include <vector>
+
+class QuadtreeVisitor {
+public:
+    virtual ~QuadtreeVisitor() {}
+
+    // Pre-order. Return false to skip the children of this node
+    virtual bool enterNode(QuadtreeNode* node, int depth) = 0;
+    // Post-order, called once all children have been left
+    virtual void leaveNode(QuadtreeNode* node, int depth) { (void)node; (void)depth; }
+};
+
+// Depth-first walk with an explicit stack, children in order 0..3
+inline void traverseQuadtree(QuadtreeNode* root, QuadtreeVisitor& visitor, int rootDepth = 0) {
+    struct Frame {
+        QuadtreeNode* node;
+        int depth;
+        bool entered;
+    };
+
+    if (!root) return;
+
+    vector<Frame> stack;
+    stack.reserve(64);
+    stack.push_back({root, rootDepth, false});
+
+    while (!stack.empty()) {
+        if (stack.back().entered) {
+            visitor.leaveNode(stack.back().node, stack.back().depth);
+            stack.pop_back();
+            continue;
+        }
+
+        stack.back().entered = true;
+        QuadtreeNode* node = stack.back().node;
+        int depth = stack.back().depth;
+
+        if (!visitor.enterNode(node, depth)) continue;
+
+        for (int i = 3; i >= 0; i--) {
+            if (node->children[i]) {
+                stack.push_back({node->children[i], depth + 1, false});
+            }
+        }
+    }
+}
+
+// Parallel walk: the nodes above splitDepth are entered on the calling thread, every
+// subtree rooted at splitDepth is walked by its own copy of the visitor (visitor.fork())
+// on a worker, and the copies are folded back with visitor.merge(). leaveNode of the upper
+// nodes runs last, children before parents.
+template <typename Visitor>
+void traverseQuadtreeParallel(QuadtreeNode* root, Visitor& visitor, int splitDepth = 2) {
+    class FrontierCollector : public QuadtreeVisitor {
+    public:
+        Visitor& target;
+        int splitDepth;
+        vector<pair<QuadtreeNode*, int>> upper;
+        vector<pair<QuadtreeNode*, int>> frontier;
+
+        FrontierCollector(Visitor& target, int splitDepth) : target(target), splitDepth(splitDepth) {}
+
+        bool enterNode(QuadtreeNode* node, int depth) override {
+            if (depth >= splitDepth) {
+                frontier.push_back({node, depth});
+                return false;
+            }
+            upper.push_back({node, depth});
+            return target.enterNode(node, depth);
+        }
+    };
+
+    FrontierCollector collector(visitor, splitDepth);
+    traverseQuadtree(root, collector);
+
+    vector<Visitor> locals;
+    locals.reserve(collector.frontier.size());
+    for (size_t i = 0; i < collector.frontier.size(); i++) {
+        locals.push_back(visitor.fork());
+    }
+
+    vector<future<void>> futures;
+    for (size_t i = 0; i < collector.frontier.size(); i++) {
+        futures.push_back(async(launch::async, [&collector, &locals, i]() {
+            traverseQuadtree(collector.frontier[i].first, locals[i], collector.frontier[i].second);
+        }));
+    }
+    for (auto& f : futures) {
+        f.wait();
+    }
+
+    for (const Visitor& local : locals) {
+        visitor.merge(local);
+    }
+
+    for (auto it = collector.upper.rbegin(); it != collector.upper.rend(); ++it) {
+        visitor.leaveNode(it->first, it->second);
+    }
+}
+
+// Depth, node count and leaf count in one walk, optionally painting the leaves as well.
+// Leaves cover disjoint rectangles, so forks can paint into the same canvas.
+class TreeSummaryVisitor : public QuadtreeVisitor {
+private:
+    TreeSummary summary;
+    Mat* canvas;
+
+public:
+    explicit TreeSummaryVisitor(Mat* canvas = nullptr) : canvas(canvas) {}
+
+    bool enterNode(QuadtreeNode* node, int depth) override {
+        // Empty halves of a 1-pixel side (lossless build) cover nothing and are not counted
+        if (node->width <= 0 || node->height <= 0) return false;
+        summary.nodeCount++;
+        summary.depth = std::max(summary.depth, depth + 1);
+
+        if (!node->isLeaf) return true;
+
+        summary.leafCount++;
+        if (canvas) {
+            int endX = std::min(node->x + node->width, canvas->cols);
+            int endY = std::min(node->y + node->height, canvas->rows);
+            int startX = std::max(0, node->x);
+            int startY = std::max(0, node->y);
+
+            if (startX < endX && startY < endY) {
+                rectangle(*canvas, Rect(startX, startY, endX - startX, endY - startY),
+                          Scalar(node->avgColor[0], node->avgColor[1], node->avgColor[2]), FILLED);
+            }
+        }
+        return false;
+    }
+
+    TreeSummaryVisitor fork() const { return TreeSummaryVisitor(canvas); }
+
+    void merge(const TreeSummaryVisitor& other) {
+        summary.nodeCount += other.summary.nodeCount;
+        summary.leafCount += other.summary.leafCount;
+        summary.depth = std::max(summary.depth, other.summary.depth);
+    }
+
+    const TreeSummary& getSummary() const { return summary; }
+};
+
+#endif
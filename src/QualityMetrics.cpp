@@ -0,0 +1,168 @@
+#include "QualityMetrics.hpp"
+#include "Quadtree.hpp"
+#include "QuadtreeTraversal.hpp"
+#include "BlockMoments.hpp"
+#include <sstream>
+#include <iomanip>
+
+double psnrFromMse(double mse) {
+    if (mse <= 1e-10) return 100.0;
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+string QualityReport::summary() const {
+    stringstream ss;
+    ss << fixed << setprecision(2) << "PSNR " << psnrTotal << " dB (B " << psnr[0] << ", G " << psnr[1]
+       << ", R " << psnr[2] << "), MSE " << mseTotal << ", SSIM " << setprecision(4) << ssim;
+    return ss.str();
+}
+
+static void finishReport(QualityReport& report, const double sse[3], double pixels) {
+    double total = 0;
+    for (int c = 0; c < 3; c++) {
+        report.mse[c] = pixels > 0 ? sse[c] / pixels : 0.0;
+        report.psnr[c] = psnrFromMse(report.mse[c]);
+        total += report.mse[c];
+    }
+    report.mseTotal = total / 3.0;
+    report.psnrTotal = psnrFromMse(report.mseTotal);
+}
+
+static double meanSsim(const Mat& original, const Mat& reconstructed) {
+    const double C1 = 6.5025, C2 = 58.5225;     // (0.01 * 255)^2, (0.03 * 255)^2
+
+    Mat x, y;
+    original.convertTo(x, CV_32F);
+    reconstructed.convertTo(y, CV_32F);
+
+    Mat xx = x.mul(x), yy = y.mul(y), xy = x.mul(y);
+    Mat muX, muY, sigmaX, sigmaY, sigmaXY;
+    GaussianBlur(x, muX, Size(11, 11), 1.5);
+    GaussianBlur(y, muY, Size(11, 11), 1.5);
+    GaussianBlur(xx, sigmaX, Size(11, 11), 1.5);
+    GaussianBlur(yy, sigmaY, Size(11, 11), 1.5);
+    GaussianBlur(xy, sigmaXY, Size(11, 11), 1.5);
+
+    Mat muXX = muX.mul(muX), muYY = muY.mul(muY), muXY = muX.mul(muY);
+    sigmaX -= muXX;
+    sigmaY -= muYY;
+    sigmaXY -= muXY;
+
+    Mat numerator = (2 * muXY + C1).mul(2 * sigmaXY + C2);
+    Mat denominator = (muXX + muYY + C1).mul(sigmaX + sigmaY + C2);
+    Mat ssimMap;
+    divide(numerator, denominator, ssimMap);
+
+    Scalar perChannel = mean(ssimMap);
+    return (perChannel[0] + perChannel[1] + perChannel[2]) / 3.0;
+}
+
+QualityReport evaluateQuality(const Mat& original, const Mat& reconstructed) {
+    QualityReport report;
+    if (original.empty() || original.size() != reconstructed.size() ||
+        original.type() != CV_8UC3 || reconstructed.type() != CV_8UC3) {
+        return report;
+    }
+
+    // One accumulator per stripe, so no stripe waits on another
+    const int stripes = std::max(1, std::min(original.rows, getNumThreads() * 4));
+    vector<Vec<int64, 3>> stripeSse(stripes, Vec<int64, 3>(0, 0, 0));
+
+    parallel_for_(Range(0, stripes), [&](const Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            int rowBegin = original.rows * s / stripes;
+            int rowEnd = original.rows * (s + 1) / stripes;
+            int64 sums[3] = {0, 0, 0};
+
+            for (int i = rowBegin; i < rowEnd; i++) {
+                const uchar* a = original.ptr<uchar>(i);
+                const uchar* b = reconstructed.ptr<uchar>(i);
+                int64 rowSums[3] = {0, 0, 0};
+                for (int j = 0; j < original.cols * 3; j += 3) {
+                    int d0 = a[j] - b[j];
+                    int d1 = a[j + 1] - b[j + 1];
+                    int d2 = a[j + 2] - b[j + 2];
+                    rowSums[0] += d0 * d0;
+                    rowSums[1] += d1 * d1;
+                    rowSums[2] += d2 * d2;
+                }
+                for (int c = 0; c < 3; c++) sums[c] += rowSums[c];
+            }
+            stripeSse[s] = Vec<int64, 3>(sums[0], sums[1], sums[2]);
+        }
+    });
+
+    double sse[3] = {0, 0, 0};
+    for (const Vec<int64, 3>& s : stripeSse) {
+        for (int c = 0; c < 3; c++) sse[c] += static_cast<double>(s[c]);
+    }
+
+    finishReport(report, sse, static_cast<double>(original.rows) * original.cols);
+    report.ssim = meanSsim(original, reconstructed);
+    return report;
+}
+
+QualityReport evaluateLeafQuality(const Mat& original, const QuadtreeNode* root) {
+    QualityReport report;
+    if (original.empty() || original.type() != CV_8UC3 || !root) return report;
+
+    class LeafCollector : public QuadtreeVisitor {
+    public:
+        vector<const QuadtreeNode*> leaves;
+        bool enterNode(QuadtreeNode* node, int) override {
+            if (node->isLeaf) leaves.push_back(node);
+            return !node->isLeaf;
+        }
+    } collector;
+    traverseQuadtree(const_cast<QuadtreeNode*>(root), collector);
+
+    struct Partial {
+        double sse[3] = {0, 0, 0};
+        double ssimArea = 0;
+        double area = 0;
+    };
+
+    const vector<const QuadtreeNode*>& leaves = collector.leaves;
+    const int chunks = std::max(1, std::min(static_cast<int>(leaves.size()), getNumThreads() * 4));
+    vector<Partial> partials(chunks);
+    const Rect bounds(0, 0, original.cols, original.rows);
+
+    parallel_for_(Range(0, chunks), [&](const Range& range) {
+        for (int k = range.start; k < range.end; k++) {
+            Partial& partial = partials[k];
+            size_t first = leaves.size() * k / chunks;
+            size_t last = leaves.size() * (k + 1) / chunks;
+
+            for (size_t l = first; l < last; l++) {
+                const QuadtreeNode* leaf = leaves[l];
+                Rect rect = Rect(leaf->x, leaf->y, leaf->width, leaf->height) & bounds;
+                if (rect.width <= 0 || rect.height <= 0) continue;
+
+                BlockMoments moments;
+                for (int i = rect.y; i < rect.y + rect.height; i++) {
+                    const Vec3b* row = original.ptr<Vec3b>(i);
+                    for (int j = rect.x; j < rect.x + rect.width; j++) moments.add(row[j]);
+                }
+
+                double n = moments.count;
+                for (int c = 0; c < 3; c++) {
+                    partial.sse[c] += moments.sseAgainst(c, leaf->avgColor[c]);
+                }
+                partial.ssimArea += moments.ssimAgainst(leaf->avgColor) * n;
+                partial.area += n;
+            }
+        }
+    });
+
+    double sse[3] = {0, 0, 0};
+    double ssimArea = 0, area = 0;
+    for (const Partial& partial : partials) {
+        for (int c = 0; c < 3; c++) sse[c] += partial.sse[c];
+        ssimArea += partial.ssimArea;
+        area += partial.area;
+    }
+
+    finishReport(report, sse, static_cast<double>(original.rows) * original.cols);
+    report.ssim = area > 0 ? ssimArea / area : 1.0;
+    return report;
+}
@@ -0,0 +1,32 @@
+#ifndef QUALITY_METRICS_HPP
+#define QUALITY_METRICS_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+class QuadtreeNode;
+
+struct QualityReport {
+    double mse[3] = {0, 0, 0};      // Per channel, BGR
+    double psnr[3] = {0, 0, 0};     // dB, capped at 100 for identical channels
+    double mseTotal = 0;
+    double psnrTotal = 0;
+    double ssim = 1.0;              // Mean over the image (or over leaves, area weighted)
+    string summary() const;
+};
+
+// PSNR from a mean squared error on 8-bit samples
+double psnrFromMse(double mse);
+
+// MSE/PSNR from row stripes summed in parallel, SSIM with the usual 11x11 Gaussian window
+QualityReport evaluateQuality(const Mat& original, const Mat& reconstructed);
+
+// Same measures straight from the leaves, without painting a reconstruction: every leaf
+// stands for a uniform block of its avgColor. SSIM here is the block SSIM of each leaf
+// against the source, weighted by leaf area.
+QualityReport evaluateLeafQuality(const Mat& original, const QuadtreeNode* root);
+
+#endif
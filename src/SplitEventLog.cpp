@@ -0,0 +1,211 @@
+#include "SplitEventLog.hpp"
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <cmath>
+
+static const char EVENT_LOG_MAGIC[4] = {'Q', 'T', 'E', 'V'};
+static const uint32_t EVENT_LOG_VERSION = 1;
+
+void SplitEventLog::reset(Size sourceSize) {
+    lock_guard<mutex> lock(eventMutex);
+    events.clear();
+    imageSize = sourceSize;
+}
+
+SplitEvent SplitEventLog::makeEvent(int x, int y, int width, int height, int depth, bool isLeaf, const Vec3b& color) {
+    SplitEvent event;
+    event.x = x;
+    event.y = y;
+    event.width = width;
+    event.height = height;
+    event.depth = static_cast<uint8_t>(std::min(depth, 255));
+    event.isLeaf = isLeaf ? 1 : 0;
+    event.color[0] = color[0];
+    event.color[1] = color[1];
+    event.color[2] = color[2];
+    return event;
+}
+
+void SplitEventLog::append(vector<SplitEvent>& collected) {
+    lock_guard<mutex> lock(eventMutex);
+    if (events.empty()) {
+        events.swap(collected);
+    } else {
+        events.insert(events.end(), collected.begin(), collected.end());
+    }
+    collected.clear();
+}
+
+bool SplitEventLog::save(const string& path) const {
+    lock_guard<mutex> lock(eventMutex);
+
+    ofstream out(path, ios::binary);
+    if (!out.is_open()) return false;
+
+    int32_t width = imageSize.width;
+    int32_t height = imageSize.height;
+    uint64_t count = events.size();
+
+    out.write(EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+    out.write(reinterpret_cast<const char*>(&EVENT_LOG_VERSION), sizeof(EVENT_LOG_VERSION));
+    out.write(reinterpret_cast<const char*>(&width), sizeof(width));
+    out.write(reinterpret_cast<const char*>(&height), sizeof(height));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(events.data()), count * sizeof(SplitEvent));
+
+    return out.good();
+}
+
+bool SplitEventLog::load(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    int32_t width = 0, height = 0;
+    uint64_t count = 0;
+
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&width), sizeof(width));
+    in.read(reinterpret_cast<char*>(&height), sizeof(height));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+    if (!in.good() || !equal(magic, magic + 4, EVENT_LOG_MAGIC) || version != EVENT_LOG_VERSION ||
+        width <= 0 || height <= 0) {
+        return false;
+    }
+
+    // The count is untrusted: it has to fit in what is left of the file before anything is allocated
+    streamoff start = in.tellg();
+    in.seekg(0, ios::end);
+    streamoff end = in.tellg();
+    in.seekg(start);
+    if (!in.good() || end < start || count > static_cast<uint64_t>(end - start) / sizeof(SplitEvent)) {
+        return false;
+    }
+
+    vector<SplitEvent> loaded(count);
+    in.read(reinterpret_cast<char*>(loaded.data()), count * sizeof(SplitEvent));
+    if (static_cast<uint64_t>(in.gcount()) != count * sizeof(SplitEvent)) return false;
+
+    lock_guard<mutex> lock(eventMutex);
+    events.swap(loaded);
+    imageSize = Size(width, height);
+    return true;
+}
+
+static Rect scaleEventRect(const SplitEvent& event, double scale) {
+    int x0 = static_cast<int>(std::floor(event.x * scale));
+    int y0 = static_cast<int>(std::floor(event.y * scale));
+    int x1 = static_cast<int>(std::floor((event.x + event.width) * scale));
+    int y1 = static_cast<int>(std::floor((event.y + event.height) * scale));
+
+    return Rect(x0, y0, std::max(1, x1 - x0), std::max(1, y1 - y0));
+}
+
+static void drawEvent(Mat& target, const SplitEvent& event, const Rect& rect) {
+    rectangle(target, rect, Scalar(event.color[0], event.color[1], event.color[2]), FILLED);
+
+    if (event.isLeaf) {
+        if (rect.width >= 8 && rect.height >= 8) {
+            rectangle(target, rect, Scalar(0, 255, 0), 1);
+        }
+        return;
+    }
+
+    // Depth palette: blue, red, orange
+    Scalar color;
+    switch (event.depth % 3) {
+        case 0: color = Scalar(255, 0, 0);   break;
+        case 1: color = Scalar(0, 0, 255);   break;
+        default: color = Scalar(0, 165, 255); break;
+    }
+
+    rectangle(target, rect, color, 1);
+
+    int midX = rect.x + rect.width / 2;
+    int midY = rect.y + rect.height / 2;
+    line(target, Point(midX, rect.y), Point(midX, rect.y + rect.height), color, 1);
+    line(target, Point(rect.x, midY), Point(rect.x + rect.width, midY), color, 1);
+}
+
+// Apply events [begin, end) of the breadth-first order. Each stripe only touches its own
+// rows, so stripes run in parallel while keeping the event order within a stripe.
+static void drawEventRange(Mat& canvas, const vector<SplitEvent>& events, const vector<uint32_t>& order,
+                           size_t begin, size_t end, double scale) {
+    int stripeHeight = std::max(16, canvas.rows / std::max(1, getNumThreads() * 2));
+    int stripeCount = (canvas.rows + stripeHeight - 1) / stripeHeight;
+
+    parallel_for_(Range(0, stripeCount), [&](const Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            int y0 = s * stripeHeight;
+            int y1 = std::min(canvas.rows, y0 + stripeHeight);
+            Mat stripe = canvas(Rect(0, y0, canvas.cols, y1 - y0));
+
+            for (size_t i = begin; i < end; i++) {
+                const SplitEvent& event = events[order[i]];
+                Rect rect = scaleEventRect(event, scale);
+                if (rect.y >= y1 || rect.y + rect.height <= y0) continue;
+
+                drawEvent(stripe, event, Rect(rect.x, rect.y - y0, rect.width, rect.height));
+            }
+        }
+    });
+}
+
+void replaySplitEvents(const SplitEventLog& log, const Mat& background, const ReplayOptions& options,
+                       const function<void(const Mat& frame, int index)>& onFrame) {
+    const vector<SplitEvent>& events = log.getEvents();
+    Size sourceSize = log.getImageSize();
+
+    if (sourceSize.width <= 0 || sourceSize.height <= 0 || options.frameCount <= 0 ||
+        options.frameSize.width <= 0 || options.frameSize.height <= 0) {
+        return;
+    }
+
+    double scale = std::min(static_cast<double>(options.frameSize.width) / sourceSize.width,
+                            static_cast<double>(options.frameSize.height) / sourceSize.height);
+    Size outputSize(std::max(1, cvRound(sourceSize.width * scale)),
+                    std::max(1, cvRound(sourceSize.height * scale)));
+
+    // Breadth-first: the log is written depth-first (and from several threads)
+    vector<uint32_t> order(events.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&events](uint32_t a, uint32_t b) {
+        return events[a].depth < events[b].depth;
+    });
+
+    Mat canvas;
+    if (!background.empty()) {
+        resize(background, canvas, outputSize, 0, 0, INTER_AREA);
+    } else {
+        canvas = Mat(outputSize, CV_8UC3, Scalar(0, 0, 0));
+    }
+
+    Mat labelled;
+    size_t applied = 0;
+
+    for (int frame = 0; frame < options.frameCount; frame++) {
+        size_t target = events.size();
+        if (options.frameCount > 1) {
+            target = static_cast<size_t>(static_cast<double>(frame) * events.size() / (options.frameCount - 1) + 0.5);
+            target = std::min(target, events.size());
+        }
+
+        if (target > applied) {
+            drawEventRange(canvas, events, order, applied, target, scale);
+            applied = target;
+        }
+
+        if (options.labelFrames) {
+            canvas.copyTo(labelled);
+            string infoText = "Frame " + to_string(frame + 1);
+            putText(labelled, infoText, Point(10, 20), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 0, 255), 1);
+            onFrame(labelled, frame);
+        } else {
+            onFrame(canvas, frame);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SPLIT_EVENT_LOG_HPP
+#define SPLIT_EVENT_LOG_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+using namespace cv;
+using namespace std;
+
+// One node decision taken during compression (21 bytes on disk)
+#pragma pack(push, 1)
+struct SplitEvent {
+    int32_t x, y, width, height;
+    uint8_t depth;
+    uint8_t isLeaf;
+    uint8_t color[3];   // BGR
+};
+#pragma pack(pop)
+
+struct ReplayOptions {
+    int frameCount = 60;
+    Size frameSize = Size(640, 480);  // Bounding box, aspect ratio is preserved
+    bool labelFrames = true;
+};
+
+class SplitEventLog {
+private:
+    vector<SplitEvent> events;
+    Size imageSize;
+    mutable mutex eventMutex;
+
+public:
+    void reset(Size sourceSize);
+    static SplitEvent makeEvent(int x, int y, int width, int height, int depth, bool isLeaf, const Vec3b& color);
+    // Build workers collect their events on their own (see BuildStats); the finished build
+    // hands them over here in one go. Empties `collected`.
+    void append(vector<SplitEvent>& collected);
+
+    size_t size() const { return events.size(); }
+    bool empty() const { return events.empty(); }
+    Size getImageSize() const { return imageSize; }
+    const vector<SplitEvent>& getEvents() const { return events; }
+
+    bool save(const string& path) const;
+    bool load(const string& path);
+};
+
+// Replay the log breadth-first (by depth) into `frameCount` frames. Frame 0 shows the
+// background, the last frame shows the finished tree. Frames are handed out in order and
+// each one is drawn in parallel row stripes, so nothing but the current canvas is kept.
+void replaySplitEvents(const SplitEventLog& log, const Mat& background, const ReplayOptions& options,
+                       const function<void(const Mat& frame, int index)>& onFrame);
+
+#endif
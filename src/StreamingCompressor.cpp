@@ -0,0 +1,89 @@
+#include "StreamingCompressor.hpp"
+#include <memory>
+
+StreamingCompressor::StreamingCompressor(Size imageSize, int tileSize, double threshold, int minBlockSize,
+                                         ErrorMethod method, TileSink sink)
+    : imageSize(imageSize),
+      tileSize(std::max(1, std::min(tileSize, 0xFFFF))),
+      threshold(threshold),
+      minBlockSize(minBlockSize),
+      errorMethod(method),
+      sink(sink),
+      bandRows(0),
+      rowsReceived(0),
+      tilesEmitted(0),
+      failed(imageSize.width <= 0 || imageSize.height <= 0) {
+
+    if (!failed) {
+        band.create(std::min(this->tileSize, imageSize.height), imageSize.width, CV_8UC3);
+    }
+}
+
+bool StreamingCompressor::pushRows(const Mat& rows) {
+    if (failed) return false;
+    if (rows.empty()) return true;
+
+    if (rows.type() != CV_8UC3 || rows.cols != imageSize.width || rowsReceived + rows.rows > imageSize.height) {
+        failed = true;
+        return false;
+    }
+
+    int consumed = 0;
+    while (consumed < rows.rows) {
+        int bandStart = rowsReceived - bandRows;
+        int bandHeight = std::min(tileSize, imageSize.height - bandStart);
+        int take = std::min(bandHeight - bandRows, rows.rows - consumed);
+
+        rows.rowRange(consumed, consumed + take).copyTo(band.rowRange(bandRows, bandRows + take));
+        bandRows += take;
+        rowsReceived += take;
+        consumed += take;
+
+        if (bandRows == bandHeight && !flushBand()) {
+            failed = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StreamingCompressor::flushBand() {
+    int bandStart = rowsReceived - bandRows;
+    int columns = (imageSize.width + tileSize - 1) / tileSize;
+    Mat rows = band.rowRange(0, bandRows);
+
+    // Tiles of one band are independent, so they are built in parallel and emitted in order
+    vector<unique_ptr<Quadtree>> trees(columns);
+    parallel_for_(Range(0, columns), [&](const Range& range) {
+        for (int c = range.start; c < range.end; c++) {
+            int x = c * tileSize;
+            int width = std::min(tileSize, imageSize.width - x);
+
+            trees[c].reset(new Quadtree(rows(Rect(x, 0, width, bandRows)), threshold, minBlockSize, errorMethod));
+            trees[c]->setBuildStrategy(BuildStrategy::BOTTOM_UP);
+            trees[c]->buildTree();
+        }
+    });
+
+    for (int c = 0; c < columns; c++) {
+        int x = c * tileSize;
+        Rect tileRect(x, bandStart, std::min(tileSize, imageSize.width - x), bandRows);
+
+        if (!sink(tilesEmitted, tileRect, trees[c]->getRoot())) return false;
+        tilesEmitted++;
+        trees[c].reset();
+    }
+
+    bandRows = 0;
+    return true;
+}
+
+bool StreamingCompressor::finish() {
+    return !failed && rowsReceived == imageSize.height && bandRows == 0;
+}
+
+StreamingCompressor::TileSink StreamingCompressor::encoderSink(QuadtreeEncoder& encoder) {
+    return [&encoder](int, const Rect&, const QuadtreeNode* root) {
+        return encoder.writeTree(root);
+    };
+}
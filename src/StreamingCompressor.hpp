@@ -0,0 +1,53 @@
+#ifndef STREAMING_COMPRESSOR_HPP
+#define STREAMING_COMPRESSOR_HPP
+
+#include <opencv2/opencv.hpp>
+#include <functional>
+#include "Quadtree.hpp"
+#include "QuadtreeCodec.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Compresses an image that arrives as bands of scanlines, e.g. from a decoder callback or a
+// camera pipeline. The image is cut into tileSize x tileSize tiles; as soon as the last row
+// of a tile row has arrived, every tile in it gets its own bottom-up tree and is handed to
+// the sink, and the rows are dropped. Memory stays at width x tileSize pixels.
+class StreamingCompressor {
+public:
+    // Called once per tile in raster order; root is only valid during the call
+    using TileSink = function<bool(int tileIndex, const Rect& tileRect, const QuadtreeNode* root)>;
+
+private:
+    Size imageSize;
+    int tileSize;
+    double threshold;
+    int minBlockSize;
+    ErrorMethod errorMethod;
+    TileSink sink;
+
+    Mat band;               // Rows of the current tile row received so far
+    int bandRows;
+    int rowsReceived;
+    int tilesEmitted;
+    bool failed;
+
+    bool flushBand();
+
+public:
+    StreamingCompressor(Size imageSize, int tileSize, double threshold, int minBlockSize,
+                        ErrorMethod method, TileSink sink);
+
+    // Any number of complete rows, CV_8UC3 and imageSize.width wide, top to bottom
+    bool pushRows(const Mat& rows);
+    // True once every row has arrived and every tile was accepted by the sink
+    bool finish();
+
+    int getRowsReceived() const { return rowsReceived; }
+    int getTilesEmitted() const { return tilesEmitted; }
+
+    // Sink that writes every tile into an open container (header.tileSize == tileSize)
+    static TileSink encoderSink(QuadtreeEncoder& encoder);
+};
+
+#endif
@@ -4,11 +4,17 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <conio.h>
+#include <io.h>
 #endif
 #include <iostream>
 #include <string>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdio>
 #include <iomanip>
 #include <vector>
 #include <algorithm>
@@ -17,6 +23,108 @@
 #include <termios.h>
 #endif
 
+// stdout masih terminal? Jika diarahkan ke file/pipe, progress bar yang digambar ulang dimatikan
+inline bool stdoutIsTerminal() {
+    #ifdef _WIN32
+        return _isatty(_fileno(stdout)) != 0;
+    #else
+        return isatty(fileno(stdout)) != 0;
+    #endif
+}
+
+// Menampung log engine selama progress bar aktif; ditulis dari thread mana pun
+class HeldLogBuffer : public std::streambuf {
+private:
+    std::string text;
+    std::mutex lock;
+    
+protected:
+    int overflow(int c) override {
+        if (c != traits_type::eof()) {
+            std::lock_guard<std::mutex> guard(lock);
+            text.push_back(static_cast<char>(c));
+        }
+        return c;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        std::lock_guard<std::mutex> guard(lock);
+        text.append(s, static_cast<size_t>(n));
+        return n;
+    }
+    
+public:
+    std::string take() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::string held;
+        held.swap(text);
+        return held;
+    }
+};
+
+// Progress bar yang digambar ulang dari thread sendiri selama pekerjaan berjalan.
+// source mengembalikan progress nyata dari engine (0..1), detail teks tambahan (boleh kosong).
+// Selama bar aktif, std::cout ditampung dan baru dicetak setelah stop(), supaya log engine
+// tidak bercampur dengan baris yang digambar ulang.
+class ProgressReporter {
+private:
+    std::string label;
+    std::function<double()> source;
+    std::function<std::string()> detail;
+    std::atomic<bool> running;
+    std::thread worker;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool enabled;
+    std::streambuf* console;        // Buffer asli std::cout selama bar aktif
+    HeldLogBuffer heldLog;
+    
+    void draw(double fraction) const {
+        const int width = 40;
+        fraction = std::min(1.0, std::max(0.0, fraction));
+        int completed = static_cast<int>(width * fraction);
+        
+        std::ostream out(console);
+        out << "\r    " << label << " [" << std::string(completed, '#') << std::string(width - completed, ' ')
+            << "] " << std::fixed << std::setprecision(1) << (fraction * 100.0) << "%";
+        if (detail) out << " " << detail();
+        out << std::flush;
+    }
+    
+public:
+    ProgressReporter(const std::string& label, std::function<double()> source,
+                     std::function<std::string()> detail = nullptr, bool enabled = stdoutIsTerminal())
+        : label(label), source(source), detail(detail), running(false), enabled(enabled), console(nullptr) {}
+    
+    ~ProgressReporter() { stop(); }
+    
+    void start() {
+        if (!enabled || running) return;
+        running = true;
+        console = std::cout.rdbuf(&heldLog);
+        worker = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            while (running) {
+                draw(source());
+                // Laju refresh saja; stop() membangunkan thread ini segera
+                wake.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !running; });
+            }
+        });
+    }
+    
+    void stop() {
+        if (!running) return;
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+        draw(source());
+        std::cout.rdbuf(console);
+        std::cout << std::endl << heldLog.take() << std::flush;
+    }
+};
+
 class QuadtreeInterface {
 private:
     bool useAnimation;
@@ -47,26 +155,16 @@ private:
         #endif
     }
     
-    // Tunggu beberapa milidetik
-    void delay(int ms) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
-    }
-    
-    // Menampilkan teks dengan efek ketik
-    void typeText(const std::string& text, int delayMs = 5) {
-        if (!useAnimation) {
-            std::cout << text;
-            return;
-        }
-        
-        for (char c : text) {
-            std::cout << c << std::flush;
-            delay(delayMs);
-        }
+    // Menampilkan teks langsung, tanpa jeda per karakter
+    void typeText(const std::string& text) {
+        std::cout << text << std::flush;
     }
     
 public:
-    QuadtreeInterface(bool animation = true) : useAnimation(animation) {}
+    // animation: progress bar hidup selama kompresi, default hanya jika stdout terminal
+    QuadtreeInterface(bool animation = stdoutIsTerminal()) : useAnimation(animation) {}
+    
+    bool isAnimated() const { return useAnimation; }
     
     // Tampilkan logo KIZUNA
     void showLogo() {
@@ -82,10 +180,6 @@ public:
         std::cout << "    =======================================================\n";
         std::cout << "    ||           QUADTREE IMAGE COMPRESSOR               ||\n";
         std::cout << "    =======================================================\n\n";
-        
-        if (useAnimation) {
-            delay(200);
-        }
     }
     
     // Tampilkan deskripsi singkat tentang program dan cara kerja
@@ -94,7 +188,7 @@ public:
         typeText("    Program ini akan membantu Anda mengompres gambar dengan menggunakan\n");
         typeText("    algoritma Divide and Conquer berbasis Quadtree. Metode ini bekerja\n");
         typeText("    dengan membagi gambar menjadi 4 bagian secara rekursif sampai bagian\n");
-        typeText("    tersebut memiliki warna yang relatif seragam.\n\n", 5);
+        typeText("    tersebut memiliki warna yang relatif seragam.\n\n");
         
         typeText("    Tekan ENTER untuk melanjutkan...");
         getch();
@@ -143,25 +237,9 @@ public:
         std::cout << "] " << std::fixed << std::setprecision(1) << (percent * 100.0) << "%" << std::endl;
     }
     
-    // Tampilkan animasi loading
-    void showLoading(const std::string& message, int durationMs = 300) {
-        if (!useAnimation) {
-            std::cout << "    " << message << "... Selesai!" << std::endl;
-            return;
-        }
-        
-        std::cout << "    " << message << "... ";
-        std::cout.flush();
-        
-        const char sequence[] = {'|', '/', '-', '\\'};
-        int count = durationMs / 50; // Lebih cepat - 50ms per karakter
-        
-        for (int i = 0; i < count; i++) {
-            std::cout << sequence[i % 4] << "\b" << std::flush;
-            delay(50); // Waktu delay lebih pendek
-        }
-        
-        std::cout << "Selesai!" << std::endl;
+    // Tampilkan langkah yang sedang dikerjakan (dicetak sebelum pekerjaan, tanpa jeda)
+    void showLoading(const std::string& message) {
+        std::cout << "    " << message << "..." << std::endl;
     }
     
     // Tampilkan tabel hasil kompresi (REVISED)
@@ -204,8 +282,7 @@ public:
         std::cout << "\n\n";
         std::cout << "    Terima kasih telah menggunakan KIZUNA Quadtree Image Compressor!\n\n";
         
-        typeText("    Sampai jumpa kembali...  ", 20);
-        delay(200);
+        typeText("    Sampai jumpa kembali...\n");
     }
 };
 
@@ -16,6 +16,9 @@
 
 #include "interface.hpp"
 #include "Quadtree.hpp"
+#include "QuadtreeCodec.hpp"
+#include "QualityMetrics.hpp"
+#include "ImageLoader.hpp"
 
 #include <opencv2/opencv.hpp>
 
@@ -57,7 +60,8 @@ string cleanPath(const string& path) {
     return cleanedPath;
 }
 
-bool validateImageFile(const string& path, string& errorMessage) {
+// Validasi dari header saja; piksel baru didekode sekali saat pemrosesan
+bool validateImageFile(const string& path, ImageProbe& probe, string& errorMessage) {
     if (!fs::exists(path)) {
         errorMessage = "File tidak ditemukan pada path: " + path;
         return false;
@@ -73,18 +77,7 @@ bool validateImageFile(const string& path, string& errorMessage) {
         return false;
     }
     
-    Mat testImage = imread(path);
-    if (testImage.empty()) {
-        errorMessage = "Tidak dapat memuat gambar. File mungkin rusak atau bukan gambar yang valid.";
-        return false;
-    }
-    
-    if (testImage.channels() != 3) {
-        errorMessage = "Gambar harus memiliki 3 kanal warna (RGB). Gambar grayscale atau dengan alpha channel mungkin tidak diproses dengan benar.";
-        return false;
-    }
-    
-    return true;
+    return probeImage(path, probe, errorMessage);
 }
 
 bool validateAndCreateDirectory(const string& path, string& errorMessage) {
@@ -122,6 +115,15 @@ bool validateThreshold(double threshold, ErrorMethod method, string& errorMessag
             }
             break;
             
+        case ErrorMethod::EDGE_AWARE:
+            maxValue = 65025.0;
+            if (threshold < 1.0) {
+                errorMessage = "Peringatan: Threshold sangat rendah untuk metode Edge-Aware. Kompresi mungkin minimal";
+            } else if (threshold > 1000.0) {
+                errorMessage = "Peringatan: Threshold sangat tinggi untuk metode Edge-Aware. Tepi halus mungkin hilang";
+            }
+            break;
+            
         case ErrorMethod::MAD:
             maxValue = 255.0;
             if (threshold < 1.0) {
@@ -166,13 +168,13 @@ bool validateThreshold(double threshold, ErrorMethod method, string& errorMessag
 }
 
 // Validate minimum block size
-bool validateMinBlockSize(int minBlockSize, const Mat& image, string& errorMessage) {
+bool validateMinBlockSize(int minBlockSize, const Size& imageSize, string& errorMessage) {
     if (minBlockSize <= 0) {
         errorMessage = "Ukuran blok minimum harus positif";
         return false;
     }
     
-    int minDimension = min(image.cols, image.rows);
+    int minDimension = min(imageSize.width, imageSize.height);
     if (minBlockSize >= minDimension / 2) {
         errorMessage = "Ukuran blok minimum terlalu besar untuk gambar ini. Maksimum yang direkomendasikan: " + 
                       to_string(minDimension / 4);
@@ -247,13 +249,28 @@ void displayRecommendedThresholds(ErrorMethod method) {
             cout << "    - Maksimum yang direkomendasikan: " << Color::RED << maxRecommended << Color::RESET << " (kompresi maksimal)\n";
             cout << "    - Nilai tipikal: " << Color::BOLD << "0.1-0.3" << Color::RESET << " untuk sebagian besar gambar\n";
             break;
+        case ErrorMethod::EDGE_AWARE:
+            minRecommended = 10.0;
+            maxRecommended = 1000.0;
+            cout << "    - Minimum yang direkomendasikan: " << Color::GREEN << minRecommended << Color::RESET << " (kompresi minimal)\n";
+            cout << "    - Nilai tengah: " << Color::YELLOW << "150.0" << Color::RESET << " (keseimbangan kualitas/kompresi)\n";
+            cout << "    - Maksimum yang direkomendasikan: " << Color::RED << maxRecommended << Color::RESET << " (kompresi maksimal)\n";
+            cout << "    - Nilai tipikal: " << Color::BOLD << "50-300" << Color::RESET << " (skala seperti Variance, tepi tipis tetap dipertahankan)\n";
+            break;
     }
     cout << "\n";
 }
 
 int main() {
     string inputImagePath, outputImagePath, gifOutputPath;
+    ImageProbe inputProbe;
+    Mat image;
     double threshold, targetCompressionPct;
+    double qualityFloor = 0.0;
+    int qualityTarget = 0;          // 0 = tidak ada, 1 = PSNR, 2 = SSIM
+    bool useBintree = false;
+    bool useLossless = false;
+    int paletteSize = 0;            // 0 = warna leaf 24-bit penuh
     int minBlockSize, errorMethodChoice;
     ErrorMethod method;
     bool visualizeGif = false;
@@ -269,7 +286,7 @@ int main() {
     SetConsoleMode(hOut, dwMode);
     #endif
     
-    QuadtreeInterface ui(true);
+    QuadtreeInterface ui;
     
     // Show program logo and introduction (still keep this for the nice logo)
     ui.showLogo();
@@ -296,7 +313,7 @@ int main() {
         
         inputImagePath = cleanPath(inputImagePath);
         
-        if (validateImageFile(inputImagePath, errorMessage)) {
+        if (validateImageFile(inputImagePath, inputProbe, errorMessage)) {
             validInputImage = true;
             ui.showSuccess("File gambar berhasil divalidasi.");
         } else {
@@ -305,10 +322,9 @@ int main() {
         }
     }
     
-    ui.showLoading("Memuat gambar");
-    Mat image = imread(inputImagePath);
-    ui.showInfo("Dimensi gambar: " + to_string(image.cols) + "x" + to_string(image.rows) + " piksel");
-    ui.showInfo("Kanal warna: " + to_string(image.channels()));
+    Size imageSize = inputProbe.size;
+    ui.showInfo("Dimensi gambar: " + to_string(imageSize.width) + "x" + to_string(imageSize.height) + " piksel");
+    ui.showInfo("Format: " + inputProbe.format);
     
     ui.showSectionHeader("METODE PENGUKURAN ERROR");
     
@@ -317,14 +333,15 @@ int main() {
     cout << "    " << Color::GREEN << "2. Mean Absolute Deviation (MAD)" << Color::RESET << " - Rata-rata perbedaan dari warna rata-rata\n";
     cout << "    " << Color::YELLOW << "3. Max Pixel Difference" << Color::RESET << " - Perbedaan warna maksimum dalam blok\n";
     cout << "    " << Color::MAGENTA << "4. Entropy" << Color::RESET << " - Pengukuran keacakan warna dari teori informasi\n";
-    cout << "    " << Color::CYAN << "5. Structural Similarity Index (SSIM)" << Color::RESET << " - Metrik kesamaan perseptual [BONUS]\n\n";
+    cout << "    " << Color::CYAN << "5. Structural Similarity Index (SSIM)" << Color::RESET << " - Metrik kesamaan perseptual [BONUS]\n";
+    cout << "    " << Color::BLUE << "6. Edge-Aware Variance" << Color::RESET << " - Variance ditambah kontras tepi (gradien Sobel) dalam blok\n\n";
     
     bool validMethod = false;
     while (!validMethod) {
-        cout << "    Masukkan pilihan (1-5): ";
+        cout << "    Masukkan pilihan (1-6): ";
         
-        if (!(cin >> errorMethodChoice) || errorMethodChoice < 1 || errorMethodChoice > 5) {
-            ui.showError("Pilihan tidak valid. Silakan masukkan angka antara 1 dan 5.");
+        if (!(cin >> errorMethodChoice) || errorMethodChoice < 1 || errorMethodChoice > 6) {
+            ui.showError("Pilihan tidak valid. Silakan masukkan angka antara 1 dan 6.");
             clearInputBuffer();
         } else {
             switch (errorMethodChoice) {
@@ -333,6 +350,7 @@ int main() {
                 case 3: method = ErrorMethod::MAX_PIXEL_DIFF; break;
                 case 4: method = ErrorMethod::ENTROPY; break;
                 case 5: method = ErrorMethod::SSIM; break;
+                case 6: method = ErrorMethod::EDGE_AWARE; break;
                 default: method = ErrorMethod::VARIANCE;
             }
             validMethod = true;
@@ -341,6 +359,38 @@ int main() {
         }
     }
     
+    ui.showSectionHeader("STRUKTUR POHON [BONUS]");
+    
+    cout << "    " << Color::BLUE << "1. Quadtree" << Color::RESET << " - Setiap blok dibagi empat\n";
+    cout << "    " << Color::GREEN << "2. Bintree" << Color::RESET << " - Setiap blok dipotong dua (horizontal atau vertikal), cocok untuk banner dan baris teks\n";
+    cout << "    " << Color::MAGENTA << "3. Quadtree lossless" << Color::RESET << " - Dibagi sampai setiap blok seragam, untuk screenshot dan aset UI\n\n";
+    
+    bool validStructure = false;
+    while (!validStructure) {
+        cout << "    Masukkan pilihan (1-3): ";
+        int structureChoice;
+        
+        if (!(cin >> structureChoice) || structureChoice < 1 || structureChoice > 3) {
+            ui.showError("Pilihan tidak valid. Silakan masukkan 1, 2, atau 3.");
+            clearInputBuffer();
+            continue;
+        }
+        
+        useBintree = (structureChoice == 2);
+        useLossless = (structureChoice == 3);
+        validStructure = true;
+        clearInputBuffer();
+        
+        if (useLossless) {
+            ui.showWarning("Mode lossless mengabaikan threshold, ukuran blok minimum, kompresi target, dan target kualitas.");
+        }
+        
+        if (useBintree && method != ErrorMethod::VARIANCE) {
+            ui.showWarning("Bintree selalu memakai kriteria Variance; metode error diganti ke Variance.");
+            method = ErrorMethod::VARIANCE;
+        }
+    }
+    
     ui.showSectionHeader("NILAI THRESHOLD");
     
     cout << "    " << Color::CYAN << "Threshold menentukan seberapa agresif gambar akan dikompresi." << Color::RESET << "\n";
@@ -352,6 +402,7 @@ int main() {
     double minRecommended = 0.0, maxRecommended = 0.0;
     switch (method) {
         case ErrorMethod::VARIANCE:
+        case ErrorMethod::EDGE_AWARE:
             minRecommended = 10.0;
             maxRecommended = 1000.0;
             break;
@@ -432,11 +483,11 @@ int main() {
     cout << "    - Untuk gambar lebih sederhana, nilai lebih besar (" << Color::YELLOW << "8-16" << Color::RESET << ") bisa lebih baik\n";
     cout << "    - Nilai antara " << Color::BOLD << "2 dan 16" << Color::RESET << " biasanya paling berguna\n\n";
     
-    int imgMin = std::min(image.cols, image.rows);
+    int imgMin = std::min(imageSize.width, imageSize.height);
     int recommendedMin = 2;
     int recommendedMax = std::min(16, imgMin / 8);
     
-    cout << "    Berdasarkan ukuran gambar Anda (" << image.cols << "x" << image.rows << "):\n";
+    cout << "    Berdasarkan ukuran gambar Anda (" << imageSize.width << "x" << imageSize.height << "):\n";
     cout << "    - Minimum yang direkomendasikan: " << Color::GREEN << recommendedMin << Color::RESET << "\n";
     cout << "    - Maksimum yang direkomendasikan: " << Color::YELLOW << recommendedMax << Color::RESET << "\n\n";
     
@@ -451,7 +502,7 @@ int main() {
         }
         
         string errorMsg;
-        if (!validateMinBlockSize(minBlockSize, image, errorMsg)) {
+        if (!validateMinBlockSize(minBlockSize, imageSize, errorMsg)) {
             ui.showError(errorMsg);
             clearInputBuffer();
             continue;
@@ -539,6 +590,66 @@ int main() {
         clearInputBuffer();
     }
     
+    ui.showSectionHeader("TARGET KUALITAS [BONUS]");
+    
+    cout << "    " << Color::CYAN << "Tree paling kasar yang masih memenuhi batas kualitas minimum." << Color::RESET << "\n";
+    cout << "    Jika aktif, threshold dan persentase kompresi target tidak dipakai.\n\n";
+    
+    bool validQuality = false;
+    while (!validQuality) {
+        cout << "    Pilih target kualitas [" << Color::BLUE << "0-Tidak" << Color::RESET << ", 1-PSNR, 2-SSIM]: ";
+        
+        if (!(cin >> qualityTarget) || qualityTarget < 0 || qualityTarget > 2) {
+            ui.showError("Input tidak valid. Silakan masukkan 0, 1, atau 2.");
+            clearInputBuffer();
+            continue;
+        }
+        
+        if (qualityTarget == 0) {
+            validQuality = true;
+            clearInputBuffer();
+            break;
+        }
+        
+        cout << (qualityTarget == 1 ? "    Masukkan PSNR minimal dalam dB (mis., 30): "
+                                    : "    Masukkan SSIM minimal (0-1, mis., 0.9): ");
+        if (!(cin >> qualityFloor) || qualityFloor <= 0.0 ||
+            (qualityTarget == 1 && qualityFloor > 100.0) || (qualityTarget == 2 && qualityFloor > 1.0)) {
+            ui.showError("Nilai target kualitas tidak valid.");
+            clearInputBuffer();
+            continue;
+        }
+        
+        validQuality = true;
+        ui.showSuccess(string("Target kualitas diatur ke: ") + (qualityTarget == 1 ? "PSNR " : "SSIM ") + to_string(qualityFloor));
+        if (qualityTarget == 2) {
+            ui.showInfo("SSIM target adalah SSIM blok rata-rata per leaf (berbobot luas), bukan SSIM Gaussian 11x11");
+        }
+        clearInputBuffer();
+    }
+    
+    ui.showSectionHeader("PALET WARNA [BONUS]");
+    
+    cout << "    " << Color::CYAN << "Warna leaf dikuantisasi ke palet (median cut + k-means, berbobot luas leaf)." << Color::RESET << "\n";
+    cout << "    Output .qtc lalu menyimpan indeks palet, bukan warna 24-bit.\n\n";
+    
+    bool validPalette = false;
+    while (!validPalette) {
+        cout << "    Masukkan jumlah warna palet [" << Color::BLUE << "0-Tidak" << Color::RESET << ", 2-65535]: ";
+        
+        if (!(cin >> paletteSize) || paletteSize < 0 || paletteSize == 1 || paletteSize > LeafPalette::MAX_COLORS) {
+            ui.showError("Input tidak valid. Silakan masukkan 0 atau nilai antara 2 dan 65535.");
+            clearInputBuffer();
+            continue;
+        }
+        
+        validPalette = true;
+        if (paletteSize > 0) {
+            ui.showSuccess("Palet warna diatur ke: " + to_string(paletteSize) + " warna");
+        }
+        clearInputBuffer();
+    }
+    
     ui.showSectionHeader("GAMBAR OUTPUT");
     
     bool validOutputPath = false;
@@ -623,7 +734,7 @@ int main() {
     if (visualizeGif) {
         bool validGifPath = false;
         while (!validGifPath) {
-            cout << "    Masukkan path file output GIF (kosongkan untuk default): ";
+            cout << "    Masukkan path file output GIF, APNG (.png) atau WebP (kosongkan untuk default): ";
             getline(cin, gifOutputPath);
             
             if (gifOutputPath.empty()) {
@@ -647,8 +758,10 @@ int main() {
             } else {
                 gifOutputPath = cleanPath(gifOutputPath);
                 
-                fs::path gifPath(gifOutputPath);
-                if (gifPath.extension().empty() || gifPath.extension() != ".gif") {
+                // GIF, APNG (.png/.apng) atau WebP animasi
+                string gifExtension = fs::path(gifOutputPath).extension().string();
+                transform(gifExtension.begin(), gifExtension.end(), gifExtension.begin(), ::tolower);
+                if (gifExtension != ".gif" && gifExtension != ".png" && gifExtension != ".apng" && gifExtension != ".webp") {
                     gifOutputPath = fs::path(gifOutputPath).replace_extension(".gif").string();
                     ui.showInfo("Menggunakan ekstensi file .gif: " + gifOutputPath);
                 }
@@ -670,6 +783,18 @@ int main() {
     cout << "    - Threshold: " << Color::YELLOW << threshold << Color::RESET << "\n";
     cout << "    - Ukuran Blok Minimum: " << Color::YELLOW << minBlockSize << Color::RESET << "\n";
     cout << "    - Kompresi Target: " << Color::YELLOW << (targetCompressionPct > 0 ? to_string(targetCompressionPct) + "%" : "Dinonaktifkan") << Color::RESET << "\n";
+    if (useBintree) {
+        cout << "    - Struktur: " << Color::YELLOW << "Bintree" << Color::RESET << "\n";
+    }
+    if (useLossless) {
+        cout << "    - Struktur: " << Color::YELLOW << "Quadtree lossless" << Color::RESET << "\n";
+    }
+    if (qualityTarget != 0) {
+        cout << "    - Target Kualitas: " << Color::YELLOW << (qualityTarget == 1 ? "PSNR >= " : "SSIM >= ") << qualityFloor << Color::RESET << "\n";
+    }
+    if (paletteSize > 0) {
+        cout << "    - Palet Warna: " << Color::YELLOW << paletteSize << " warna" << Color::RESET << "\n";
+    }
     cout << "    - Gambar Output: " << Color::YELLOW << outputImagePath << Color::RESET << "\n";
     cout << "    - Buat GIF: " << Color::YELLOW << (visualizeGif ? "Ya" : "Tidak") << Color::RESET << "\n";
     if (visualizeGif) {
@@ -698,28 +823,74 @@ int main() {
     ui.showInfo("Memulai proses kompresi...");
     
     try {
-        // Show progress without actual delays for better performance
-        for (int i = 0; i <= 100; i += 5) {
-            ui.showProgressBar(i, 100);
-            std::this_thread::sleep_for(std::chrono::milliseconds(5)); // Very short delay
+        // Satu kali decode. Dengan target kompresi sangat tinggi gambar didekode pada skala
+        // tereduksi (JPEG dari DCT, format lain lewat box pyramid); kompresi dan rekonstruksi
+        // berjalan pada skala itu, output tetap berukuran asli
+        ui.showLoading("Memuat gambar");
+        int decodeScale = 1;
+        if (qualityTarget == 0 && !useLossless) {
+            decodeScale = chooseDecodeScale(inputProbe, targetCompressionPct);
+        }
+        image = loadImage(inputImagePath, inputProbe, decodeScale, &decodeScale);
+        if (image.empty()) {
+            ui.showError("Tidak dapat memuat gambar. File mungkin rusak atau bukan gambar yang valid.");
+            return 1;
         }
+        // Ukuran output dari gambar yang benar-benar didekode, jadi orientasi EXIF yang
+        // diterapkan imread tidak menghasilkan ukuran yang tertukar
+        imageSize = sourceGeometry(inputProbe, image, decodeScale);
         
-        ui.showLoading("Membuat quadtree", 50);
-        Quadtree quadtree(image, threshold, minBlockSize, method, targetCompressionPct, visualizeGif);
+        double engineTargetPct = targetCompressionPct;
+        int engineMinBlockSize = minBlockSize;
+        if (decodeScale > 1) {
+            engineTargetPct = scaledTargetCompression(targetCompressionPct, decodeScale);
+            engineMinBlockSize = max(1, minBlockSize / decodeScale);
+            ui.showInfo("Gambar didekode pada skala 1/" + to_string(decodeScale) + " (" + to_string(image.cols) + "x" +
+                        to_string(image.rows) + "), target kompresi pada skala ini: " + to_string(engineTargetPct) + "%");
+        }
+        
+        ui.showLoading("Membuat quadtree");
+        Quadtree quadtree(image, threshold, engineMinBlockSize, method, engineTargetPct, visualizeGif);
+        quadtree.setOutputGeometry(decodeScale, imageSize);
+        quadtree.setNumaAware(true);    // Hanya aktif pada host dengan lebih dari satu node NUMA
+        if (qualityTarget == 1) quadtree.setTargetPsnr(qualityFloor);
+        if (qualityTarget == 2) quadtree.setTargetSsim(qualityFloor);
+        quadtree.setBintreeMode(useBintree);
+        quadtree.setLossless(useLossless);
+        quadtree.setPaletteSize(paletteSize);
         
-        ui.showLoading("Mengompresi gambar", 50);
-        quadtree.compressImage();
+        ui.showLoading("Mengompresi gambar");
+        {
+            // Progress nyata dari engine: luas leaf yang sudah final dan jumlah node
+            ProgressReporter progress("Kompresi", [&quadtree]() { return quadtree.getProgress(); },
+                                      [&quadtree]() { return "(" + to_string(quadtree.getNodesProcessed()) + " node)"; },
+                                      ui.isAnimated());
+            progress.start();
+            quadtree.compressImage();
+            progress.stop();
+        }
         
-        ui.showLoading("Merekonstruksi gambar", 50);
+        ui.showLoading("Merekonstruksi gambar");
         Mat compressedImage = image.clone();
-        quadtree.reconstructImage(compressedImage);
+        TreeSummary treeSummary;
+        quadtree.reconstructImage(compressedImage, &treeSummary);
         
         auto end = chrono::high_resolution_clock::now();
         double execTime = chrono::duration<double, milli>(end - start).count();
         
+        // Kualitas hasil rekonstruksi dibanding gambar asli (pada skala decode)
+        QualityReport quality = evaluateQuality(image, compressedImage);
+        
+        if (compressedImage.size() != imageSize &&
+            !expandScaledImage(compressedImage, decodeScale, imageSize, compressedImage)) {
+            ui.showError("Ukuran output " + to_string(imageSize.width) + "x" + to_string(imageSize.height) +
+                         " tidak sesuai dengan gambar hasil decode pada skala 1/" + to_string(decodeScale) + ".");
+            return 1;
+        }
+        
         
         if (saveOutput) {
-            ui.showLoading("Menyimpan gambar terkompresi", 50);
+            ui.showLoading("Menyimpan gambar terkompresi");
             
             try {
                 fs::path outputDir = fs::path(outputImagePath).parent_path();
@@ -759,7 +930,13 @@ int main() {
                 compressionParams.push_back(80);
             }
             
-            bool saveSuccess = imwrite(outputImagePath, compressedImage, compressionParams);
+            bool saveSuccess;
+            if (extension == ".qtc") {
+                // Container native quadtree, bukan raster
+                saveSuccess = quadtree.saveContainer(outputImagePath);
+            } else {
+                saveSuccess = imwrite(outputImagePath, compressedImage, compressionParams);
+            }
             
             if (!saveSuccess) {
                 ui.showError("Gagal menyimpan gambar terkompresi. Perbandingan masih bisa dilihat.");
@@ -771,7 +948,7 @@ int main() {
         }
         
         if (visualizeGif) {
-            ui.showLoading("Membuat visualisasi GIF", 50);
+            ui.showLoading("Membuat visualisasi GIF");
             
             try {
                 fs::path gifDir = fs::path(gifOutputPath).parent_path();
@@ -783,7 +960,7 @@ int main() {
                 ui.showInfo("Mencoba menyimpan file GIF...");
             }
             
-            bool gifSuccess = quadtree.saveGifAnimation(gifOutputPath);
+            bool gifSuccess = quadtree.saveAnimation(gifOutputPath);
             if (!gifSuccess) {
                 ui.showWarning("Gagal membuat visualisasi GIF. Melanjutkan...");
             } else {
@@ -791,8 +968,8 @@ int main() {
             }
         }
         
-        int treeDepth = quadtree.getTreeDepth();
-        int nodeCount = quadtree.getNodeCount();
+        int treeDepth = treeSummary.depth;
+        int nodeCount = treeSummary.nodeCount;
         
         // Hitung persentase kompresi berdasarkan ukuran file (sesuai rumus)
         double compressionPercentage = 0.0;
@@ -801,8 +978,8 @@ int main() {
             compressionPercentage = quadtree.calculateCompressionPercentage(inputImagePath, outputImagePath);
         } else {
             // Jika gambar tidak disimpan, gunakan node-based metric
-            int totalPixels = image.rows * image.cols;
-            int leafNodes = quadtree.countLeafNodes(quadtree.getRoot());
+            int totalPixels = imageSize.width * imageSize.height;   // Ukuran asli, juga saat decode tereduksi
+            int leafNodes = treeSummary.leafCount;
             compressionPercentage = (1.0 - (double)leafNodes / totalPixels) * 100.0;
         }
         
@@ -841,8 +1018,23 @@ int main() {
                 }()
             },
             {"Kedalaman Quadtree", to_string(treeDepth)},
-            {"Jumlah node dalam Quadtree", to_string(nodeCount)}
+            {"Jumlah node dalam Quadtree", to_string(nodeCount)},
+            {"PSNR (B/G/R)",
+                [&quality]() {
+                    stringstream ss;
+                    ss << fixed << setprecision(2) << quality.psnr[0] << " / " << quality.psnr[1]
+                       << " / " << quality.psnr[2] << " dB";
+                    return ss.str();
+                }()
+            },
+            {"PSNR total", to_string(quality.psnrTotal) + " dB"},
+            {"MSE", to_string(quality.mseTotal)},
+            {"SSIM (Gaussian 11x11)", to_string(quality.ssim)}
         };
+        if (qualityTarget == 2 && quadtree.getRoot()) {
+            // Metrik yang sama dengan target SSIM
+            resultData.push_back({"SSIM blok (target)", to_string(evaluateLeafQuality(image, quadtree.getRoot()).ssim)});
+        }
         
         ui.showResultTable("HASIL KOMPRESI", resultData);
         
@@ -870,7 +1062,12 @@ int main() {
         namedWindow("Gambar Asli", WINDOW_NORMAL);
         imshow("Gambar Asli", image);
         
-        Mat compressedImage = imread(outputImagePath);
+        Mat compressedImage;
+        if (fs::path(outputImagePath).extension() == ".qtc") {
+            decodeContainer(outputImagePath, compressedImage);
+        } else {
+            compressedImage = imread(outputImagePath);
+        }
         if (!compressedImage.empty()) {
             namedWindow("Gambar Terkompresi", WINDOW_NORMAL);
             imshow("Gambar Terkompresi", compressedImage);
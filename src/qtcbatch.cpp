@@ -0,0 +1,168 @@
+// Batch compressor: every image of the inputs with the same settings, one image per worker.
+//
+//   qtcbatch <image|directory>... -o <output directory> [--format png|qtc|...] [--jobs N]
+//            [--method variance|mad|maxdiff|entropy|ssim|edge] [--threshold T] [--min-block N]
+//            [--target percent] [--bottom-up] [--palette colors] [--lossless] [--verbose]
+//
+// Directories are read one level deep. Engine logs are dropped unless --verbose is given,
+// since the workers would interleave them.
+#include "BatchCompressor.hpp"
+#include "ImageLoader.hpp"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+// Discards everything, without any state shared between the writing threads
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+static void printUsage() {
+    cout << "Usage: qtcbatch <image|directory>... -o <output directory> [--format png|qtc|...] [--jobs N]" << endl
+         << "                [--method variance|mad|maxdiff|entropy|ssim|edge] [--threshold T] [--min-block N]" << endl
+         << "                [--target percent] [--bottom-up] [--palette colors] [--lossless] [--verbose]" << endl;
+}
+
+static bool parseMethod(const string& name, ErrorMethod& method) {
+    if (name == "variance") method = ErrorMethod::VARIANCE;
+    else if (name == "mad") method = ErrorMethod::MAD;
+    else if (name == "maxdiff") method = ErrorMethod::MAX_PIXEL_DIFF;
+    else if (name == "entropy") method = ErrorMethod::ENTROPY;
+    else if (name == "ssim") method = ErrorMethod::SSIM;
+    else if (name == "edge") method = ErrorMethod::EDGE_AWARE;
+    else return false;
+    return true;
+}
+
+static bool isImageFile(const fs::path& path) {
+    string extension = path.extension().string();
+    for (char& c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    const char* known[] = {".jpg", ".jpeg", ".png", ".webp", ".bmp", ".tif", ".tiff", ".ppm", ".pgm", ".pnm"};
+    return find(begin(known), end(known), extension) != end(known);
+}
+
+int main(int argc, char** argv) {
+    vector<string> inputs;
+    string outputDir, format = "png";
+    BatchSettings settings;
+    int jobs = 0;
+    bool verbose = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "-o" && hasValue) {
+                outputDir = argv[++i];
+            } else if (arg == "--format" && hasValue) {
+                format = argv[++i];
+            } else if (arg == "--jobs" && hasValue) {
+                jobs = stoi(argv[++i]);
+            } else if (arg == "--method" && hasValue) {
+                if (!parseMethod(argv[++i], settings.method)) {
+                    printUsage();
+                    return 2;
+                }
+            } else if (arg == "--threshold" && hasValue) {
+                settings.threshold = stod(argv[++i]);
+            } else if (arg == "--min-block" && hasValue) {
+                settings.minBlockSize = std::max(1, stoi(argv[++i]));
+            } else if (arg == "--target" && hasValue) {
+                settings.targetCompressionPct = stod(argv[++i]);
+            } else if (arg == "--palette" && hasValue) {
+                settings.paletteSize = stoi(argv[++i]);
+            } else if (arg == "--bottom-up") {
+                settings.strategy = BuildStrategy::BOTTOM_UP;
+            } else if (arg == "--lossless") {
+                settings.lossless = true;
+            } else if (arg == "--verbose") {
+                verbose = true;
+            } else if (arg == "-h" || arg == "--help") {
+                printUsage();
+                return 0;
+            } else if (arg[0] != '-') {
+                inputs.push_back(arg);
+            } else {
+                printUsage();
+                return 2;
+            }
+        }
+    } catch (const exception&) {
+        printUsage();
+        return 2;
+    }
+
+    if (inputs.empty() || outputDir.empty()) {
+        printUsage();
+        return 2;
+    }
+
+    // Inputs in a stable order; output names follow the input names
+    vector<fs::path> files;
+    for (const string& input : inputs) {
+        std::error_code ec;
+        if (fs::is_directory(input, ec)) {
+            for (const auto& entry : fs::directory_iterator(input, ec)) {
+                if (entry.is_regular_file() && isImageFile(entry.path())) files.push_back(entry.path());
+            }
+        } else {
+            files.push_back(input);
+        }
+    }
+    sort(files.begin(), files.end());
+
+    std::error_code ec;
+    fs::create_directories(outputDir, ec);
+    if (format[0] == '.') format = format.substr(1);
+
+    vector<BatchJob> batch;
+    for (const fs::path& file : files) {
+        batch.push_back({file.string(), (fs::path(outputDir) / (file.stem().string() + "." + format)).string()});
+    }
+    if (batch.empty()) {
+        cerr << "Error: no input images" << endl;
+        return 1;
+    }
+
+    BatchCompressor compressor(settings, jobs);
+    cout << "Compressing " << batch.size() << " images on " << compressor.workerCount() << " workers" << endl;
+
+    NullBuffer discard;
+    streambuf* console = cout.rdbuf();
+    if (!verbose) cout.rdbuf(&discard);
+
+    auto start = chrono::steady_clock::now();
+    vector<BatchResult> results = compressor.run(batch, nullptr, [](int done, int total) {
+        cerr << "\r  " << done << "/" << total << flush;
+    });
+    double totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    cout.rdbuf(console);
+    cerr << endl;
+
+    int failed = 0;
+    cout << fixed << setprecision(2);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchResult& result = results[i];
+        cout << "  " << fs::path(batch[i].inputPath).filename().string() << ": ";
+        if (!result.ok) {
+            cout << "FAILED (" << result.error << ")" << endl;
+            failed++;
+            continue;
+        }
+        cout << result.size.width << "x" << result.size.height << ", " << result.leaves << " leaves";
+        if (result.psnr > 0.0) cout << ", PSNR " << result.psnr << " dB";
+        cout << ", " << result.milliseconds << " ms (worker " << result.worker << ")" << endl;
+    }
+
+    cout << "Done: " << results.size() - failed << " of " << results.size() << " images in " << totalMs << " ms ("
+         << results.size() * 1000.0 / std::max(1.0, totalMs) << " images/s)" << endl;
+    cout << "Worker scratch kept for the next batch: " << compressor.bytesReserved() / 1024 << " KiB" << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+// Standalone .qtc decoder and inspector. Only the codec is linked: no interactive UI,
+// no compression engine.
+//
+//   qtcdecode input.qtc [-o output.png|.ppm|.raw] [--lod depth] [--stats]
+//
+// .ppm is binary P6, .raw is packed 8-bit RGB without a header (size from --stats),
+// any other extension goes through imwrite.
+#include "QuadtreeCodec.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+static void printUsage() {
+    cout << "Usage: qtcdecode <input.qtc> [-o <output.png|.ppm|.raw>] [--lod <depth>] [--stats]" << endl;
+}
+
+static bool writeRgb(const string& path, const Mat& image, bool ppmHeader) {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out.is_open()) return false;
+
+    if (ppmHeader) {
+        out << "P6\n" << image.cols << " " << image.rows << "\n255\n";
+    }
+
+    vector<uchar> row(static_cast<size_t>(image.cols) * 3);
+    for (int i = 0; i < image.rows; i++) {
+        const uchar* bgr = image.ptr<uchar>(i);
+        for (int j = 0; j < image.cols * 3; j += 3) {
+            row[j] = bgr[j + 2];
+            row[j + 1] = bgr[j + 1];
+            row[j + 2] = bgr[j];
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return out.good();
+}
+
+static void printStats(const string& path, const ContainerStats& stats, double decodeMs) {
+    const ContainerHeader& header = stats.header;
+    cout << "Container: " << path << endl;
+    cout << "  Size: " << header.width << "x" << header.height
+         << ", kind: " << (header.kind == ContainerKind::BINTREE ? "bintree" : "quadtree")
+         << ", tiles: " << stats.tiles << "/" << header.tileCount()
+         << (header.tileSize > 0 ? " of " + to_string(header.tileSize) + " px" : string()) << endl;
+    cout << "  Flags:" << (header.flags & CONTAINER_FLAG_PALETTE ? " palette" : "")
+         << (header.flags & CONTAINER_FLAG_RUNS ? " runs" : "")
+         << (header.flags == 0 ? " none" : "") << endl;
+
+    cout << "  Depth  Nodes      Leaves" << endl;
+    int totalNodes = 0, totalLeaves = 0;
+    for (size_t d = 0; d < stats.nodesPerDepth.size(); d++) {
+        cout << "  " << setw(5) << d << "  " << setw(9) << stats.nodesPerDepth[d]
+             << "  " << setw(9) << stats.leavesPerDepth[d] << endl;
+        totalNodes += stats.nodesPerDepth[d];
+        totalLeaves += stats.leavesPerDepth[d];
+    }
+    cout << "  Total  " << setw(9) << totalNodes << "  " << setw(9) << totalLeaves << endl;
+
+    size_t totalBytes = 16;
+    cout << "  Section  Bytes" << endl;
+    cout << "  header   " << 16 << endl;
+    for (const auto& section : stats.chunkBytes) {
+        cout << "  " << left << setw(7) << section.first << right << "  " << section.second << endl;
+        totalBytes += section.second;
+    }
+    cout << "  QEND     8" << endl;
+    totalBytes += 8;
+
+    std::error_code ec;
+    uintmax_t fileBytes = fs::file_size(path, ec);
+    cout << "  Total    " << totalBytes;
+    if (!ec) cout << " (file " << fileBytes << ")";
+    cout << endl;
+
+    cout << fixed << setprecision(2) << "  Decode time: " << decodeMs << " ms" << endl;
+}
+
+int main(int argc, char** argv) {
+    string inputPath, outputPath;
+    int lod = -1;
+    bool showStats = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--lod" && i + 1 < argc) {
+            try {
+                lod = stoi(argv[++i]);
+            } catch (const exception&) {
+                printUsage();
+                return 2;
+            }
+        } else if (arg == "--stats") {
+            showStats = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (inputPath.empty() && arg[0] != '-') {
+            inputPath = arg;
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    if (inputPath.empty() || (outputPath.empty() && !showStats)) {
+        printUsage();
+        return 2;
+    }
+
+    Mat image;
+    ContainerStats stats;
+    auto start = chrono::high_resolution_clock::now();
+    bool decoded = decodeContainer(inputPath, image, lod, &stats);
+    double decodeMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+    if (!decoded) {
+        cerr << "Error: cannot decode " << inputPath << endl;
+        return 1;
+    }
+
+    if (showStats) {
+        printStats(inputPath, stats, decodeMs);
+    }
+
+    if (!outputPath.empty()) {
+        string extension = fs::path(outputPath).extension().string();
+        for (char& c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+
+        bool written;
+        if (extension == ".ppm") {
+            written = writeRgb(outputPath, image, true);
+        } else if (extension == ".raw") {
+            written = writeRgb(outputPath, image, false);
+        } else {
+            written = imwrite(outputPath, image);
+        }
+
+        if (!written) {
+            cerr << "Error: cannot write " << outputPath << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
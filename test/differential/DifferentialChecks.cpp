@@ -0,0 +1,398 @@
+#include "DifferentialChecks.hpp"
+#include "BuildArena.hpp"
+#include "QuadtreeCodec.hpp"
+#include "ImageLoader.hpp"
+#include <cmath>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Friend of Quadtree: the reference metrics and the fast paths they stand behind
+struct QuadtreeTestAccess {
+    static void configure(Quadtree& tree, ErrorMethod method, double threshold) {
+        tree.errorMethod = method;
+        tree.threshold = threshold;
+    }
+
+    static double reference(Quadtree& tree, ErrorMethod method, const Mat& block, const Mat& leafBlock) {
+        switch (method) {
+            case ErrorMethod::VARIANCE: return tree.calculateVariance(block);
+            case ErrorMethod::MAD: return tree.calculateMAD(block);
+            case ErrorMethod::MAX_PIXEL_DIFF: return tree.calculateMaxPixelDiff(block);
+            case ErrorMethod::ENTROPY: return tree.calculateEntropy(block);
+            case ErrorMethod::SSIM: return tree.calculateSSIM(block, leafBlock);
+            default: return tree.calculateError(block);
+        }
+    }
+
+    static double variance(Quadtree& tree, const Mat& block) { return tree.calculateVariance(block); }
+    static double maxPixelDiff(Quadtree& tree, const Mat& block) { return tree.calculateMaxPixelDiff(block); }
+    static double ssim(Quadtree& tree, const Mat& block, const Mat& avgBlock) { return tree.calculateSSIM(block, avgBlock); }
+    static double ssimFromMoments(Quadtree& tree, const BlockMoments& moments, bool smallBlock) {
+        return tree.ssimFromMoments(moments, smallBlock);
+    }
+    static double uniformBlockSSIM(Quadtree& tree, const Mat& block) { return tree.uniformBlockSSIM(block); }
+
+    // Split point as compressNode passes it for a block at the node origin
+    static bool errorReaches(Quadtree& tree, const Mat& block, double limit, const BlockMoments* known,
+                             BlockMoments& total) {
+        BlockMoments children[4];
+        bool childrenValid = false;
+        return tree.errorReachesThreshold(block, limit, std::max(1, block.cols / 2), std::max(1, block.rows / 2),
+                                          known, total, children, childrenValid);
+    }
+
+    static bool mergedReaches(Quadtree& tree, const Mat& block, const Rect& rect, const BlockMoments& moments,
+                              const int* histogram) {
+        return tree.mergedErrorReaches(block, rect, moments, histogram);
+    }
+};
+
+static bool near(double a, double b) {
+    return std::abs(a - b) <= 1e-7 * std::max(1.0, std::max(std::abs(a), std::abs(b)));
+}
+
+static string describe(const string& what, const Rect& rect, double fast, double reference) {
+    stringstream ss;
+    ss << what << " on " << rect.width << "x" << rect.height << " at (" << rect.x << ", " << rect.y << "): "
+       << setprecision(17) << fast << " vs reference " << reference;
+    return ss.str();
+}
+
+static Vec3b randomColor(mt19937& rng) {
+    uniform_int_distribution<int> value(0, 255);
+    return Vec3b(static_cast<uchar>(value(rng)), static_cast<uchar>(value(rng)), static_cast<uchar>(value(rng)));
+}
+
+Mat makeTestImage(mt19937& rng, Size size, TestPattern pattern) {
+    Mat image(size, CV_8UC3, Scalar::all(0));
+    uniform_int_distribution<int> value(0, 255);
+
+    switch (pattern) {
+        case TestPattern::NOISE:
+            for (int i = 0; i < image.rows; i++) {
+                Vec3b* row = image.ptr<Vec3b>(i);
+                for (int j = 0; j < image.cols; j++) row[j] = randomColor(rng);
+            }
+            break;
+        case TestPattern::FLAT:
+            image.setTo(Scalar(value(rng), value(rng), value(rng)));
+            break;
+        case TestPattern::GRADIENT: {
+            Vec3b from = randomColor(rng), to = randomColor(rng);
+            for (int i = 0; i < image.rows; i++) {
+                Vec3b* row = image.ptr<Vec3b>(i);
+                for (int j = 0; j < image.cols; j++) {
+                    double t = (i + j) / std::max(1.0, image.rows + image.cols - 2.0);
+                    for (int c = 0; c < 3; c++) row[j][c] = saturate_cast<uchar>(from[c] + (to[c] - from[c]) * t);
+                }
+            }
+            break;
+        }
+        case TestPattern::BLOCKS: {
+            // Flat rectangles: large uniform areas the builders have to agree on merging
+            int count = 1 + static_cast<int>(image.total() / 4096);
+            for (int k = 0; k < count; k++) {
+                uniform_int_distribution<int> x(0, image.cols - 1), y(0, image.rows - 1);
+                int x0 = x(rng), y0 = y(rng), x1 = x(rng), y1 = y(rng);
+                Rect rect(Point(std::min(x0, x1), std::min(y0, y1)), Point(std::max(x0, x1) + 1, std::max(y0, y1) + 1));
+                Vec3b color = randomColor(rng);
+                image(rect).setTo(Scalar(color[0], color[1], color[2]));
+            }
+            break;
+        }
+        case TestPattern::FEW_COLORS: {
+            Vec3b colors[3] = {randomColor(rng), randomColor(rng), randomColor(rng)};
+            uniform_int_distribution<int> pick(0, 2), run(1, 16);
+            Vec3b* pixels = image.ptr<Vec3b>(0);
+            for (size_t p = 0; p < image.total();) {
+                Vec3b color = colors[pick(rng)];
+                for (int r = run(rng); r > 0 && p < image.total(); r--) pixels[p++] = color;
+            }
+            break;
+        }
+    }
+    return image;
+}
+
+double thresholdRange(ErrorMethod method) {
+    switch (method) {
+        case ErrorMethod::MAD: return 60.0;
+        case ErrorMethod::MAX_PIXEL_DIFF: return 200.0;
+        case ErrorMethod::ENTROPY: return 5.0;
+        case ErrorMethod::SSIM: return 0.5;
+        default: return 1500.0;
+    }
+}
+
+void checkBlockMetrics(const Mat& image, const Rect& rect, DifferentialReport& report) {
+    const Mat block = image(rect);
+    const int n = rect.area();
+
+    // Minimum block size 4: calculateError applies no small-block substitutes
+    BuildArena arena;
+    Quadtree tree(image, 1.0, 4, ErrorMethod::VARIANCE, 0.0, false, &arena);
+
+    BlockMoments moments;
+    int histogram[768] = {0};
+    for (int i = 0; i < block.rows; i++) {
+        const Vec3b* row = block.ptr<Vec3b>(i);
+        for (int j = 0; j < block.cols; j++) {
+            moments.add(row[j]);
+            histogram[row[j][0]]++;
+            histogram[256 + row[j][1]]++;
+            histogram[512 + row[j][2]]++;
+        }
+    }
+
+    double variance = QuadtreeTestAccess::variance(tree, block);
+    report.expect(near(moments.variance(), variance), describe("BlockMoments::variance", rect, moments.variance(), variance));
+
+    if (n > 4) {
+        double range = QuadtreeTestAccess::maxPixelDiff(tree, block);
+        report.expect(moments.maxPixelDiff() == range, describe("BlockMoments::maxPixelDiff", rect, moments.maxPixelDiff(), range));
+    }
+
+    // Leaves are painted with the truncated mean; uniformBlockSSIM stands for the rounded one
+    Vec3b leaf = moments.meanColor();
+    Mat leafBlock(block.size(), block.type(), Scalar(leaf[0], leaf[1], leaf[2]));
+    Scalar mu = mean(block);
+    Mat meanBlock(block.size(), block.type(), Scalar(mu[0], mu[1], mu[2]));
+    bool smallBlock = block.rows < 4 || block.cols < 4;
+
+    double leafSsim = QuadtreeTestAccess::ssim(tree, block, leafBlock);
+    double fromMoments = QuadtreeTestAccess::ssimFromMoments(tree, moments, smallBlock);
+    report.expect(near(fromMoments, leafSsim), describe("ssimFromMoments", rect, fromMoments, leafSsim));
+
+    double meanSsim = QuadtreeTestAccess::ssim(tree, block, meanBlock);
+    double uniform = QuadtreeTestAccess::uniformBlockSSIM(tree, block);
+    report.expect(near(uniform, meanSsim), describe("uniformBlockSSIM", rect, uniform, meanSsim));
+
+    // Bounded decisions, taken by compressNode and mergeBuild from 16 pixels on
+    if (n < 16) return;
+
+    const ErrorMethod methods[] = {ErrorMethod::VARIANCE, ErrorMethod::MAD, ErrorMethod::MAX_PIXEL_DIFF,
+                                   ErrorMethod::ENTROPY, ErrorMethod::SSIM};
+    for (ErrorMethod method : methods) {
+        double reference = QuadtreeTestAccess::reference(tree, method, block, leafBlock);
+        vector<double> limits;
+        if (reference > 0.0) {
+            limits = {reference * 0.5, reference * 0.999, reference * 1.001, reference * 2.0};
+        } else {
+            limits = {0.0, 1e-3, 1.0};
+        }
+
+        for (double limit : limits) {
+            bool expected = reference >= limit;
+            string name = getErrorMethodName(method);
+            QuadtreeTestAccess::configure(tree, method, limit);
+
+            BlockMoments total;
+            bool scanned = QuadtreeTestAccess::errorReaches(tree, block, limit, nullptr, total);
+            report.expect(scanned == expected, describe(name + " errorReachesThreshold, limit " + to_string(limit),
+                                                        rect, scanned, reference));
+            if (!scanned) {
+                // A leaf keeps the moments of the scan for its color and error
+                report.expect(total.count == n && total.meanColor() == leaf,
+                              describe(name + " leaf moments", rect, total.count, n));
+            }
+
+            bool known = QuadtreeTestAccess::errorReaches(tree, block, limit, &moments, total);
+            report.expect(known == expected, describe(name + " errorReachesThreshold with known moments, limit " +
+                                                      to_string(limit), rect, known, reference));
+
+            bool merged = QuadtreeTestAccess::mergedReaches(tree, block, rect, moments, histogram);
+            report.expect(merged == expected, describe(name + " mergedErrorReaches, limit " + to_string(limit),
+                                                       rect, merged, reference));
+        }
+    }
+}
+
+static bool sameTree(const QuadtreeNode* a, const QuadtreeNode* b, string& where) {
+    if (!a || !b) {
+        if (a != b) where = "missing node";
+        return a == b;
+    }
+
+    stringstream ss;
+    ss << (a->isLeaf ? "leaf " : "node ") << a->width << "x" << a->height << " at (" << a->x << ", " << a->y << ")";
+    if (a->x != b->x || a->y != b->y || a->width != b->width || a->height != b->height || a->isLeaf != b->isLeaf) {
+        where = ss.str() + " has a different shape";
+        return false;
+    }
+    // Internal nodes carry no color the output depends on
+    if (a->isLeaf) {
+        if (a->avgColor != b->avgColor) {
+            where = ss.str() + " has a different color";
+            return false;
+        }
+        return true;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (!sameTree(a->children[i], b->children[i], where)) return false;
+    }
+    return true;
+}
+
+// The reference painter: every leaf on its own, clipped to the image
+static void paintLeaves(const QuadtreeNode* node, Mat& image) {
+    if (!node) return;
+    if (node->isLeaf) {
+        Rect rect = Rect(node->x, node->y, node->width, node->height) & Rect(0, 0, image.cols, image.rows);
+        if (rect.area() > 0) {
+            image(rect).setTo(Scalar(node->avgColor[0], node->avgColor[1], node->avgColor[2]));
+        }
+        return;
+    }
+    for (int i = 0; i < 4; i++) paintLeaves(node->children[i], image);
+}
+
+static string describeBuild(const Mat& image, ErrorMethod method, double threshold, int minBlockSize) {
+    stringstream ss;
+    ss << image.cols << "x" << image.rows << ", " << getErrorMethodName(method) << ", threshold " << threshold
+       << ", min block " << minBlockSize;
+    return ss.str();
+}
+
+void checkTreeBuilds(const Mat& image, ErrorMethod method, double threshold, int minBlockSize,
+                     DifferentialReport& report) {
+    if (image.total() > 500000) return;
+    const string build = describeBuild(image, method, threshold, minBlockSize);
+
+    Quadtree reference(image, threshold, minBlockSize, method);
+    reference.buildTree();
+    // The top-down build stops at its node limit; the other builds have none
+    if (!reference.hasCompleteDistortion()) return;
+
+    string where;
+    Quadtree bottomUp(image, threshold, minBlockSize, method);
+    bottomUp.setBuildStrategy(BuildStrategy::BOTTOM_UP);
+    bottomUp.buildTree();
+    report.expect(sameTree(reference.getRoot(), bottomUp.getRoot(), where), "bottom-up build, " + build + ": " + where);
+
+    BuildArena arena;
+    Quadtree pooled(image, threshold, minBlockSize, method, 0.0, false, &arena);
+    pooled.buildTree();
+    report.expect(sameTree(reference.getRoot(), pooled.getRoot(), where), "arena build, " + build + ": " + where);
+
+    // Sampled estimation (here from 64 pixels on) gives the same tree on every build
+    Quadtree sampled(image, threshold, minBlockSize, method);
+    sampled.setSampledEstimation(true, 64, 16);
+    sampled.buildTree();
+    Quadtree resampled(image, threshold, minBlockSize, method);
+    resampled.setSampledEstimation(true, 64, 16);
+    resampled.buildTree();
+    report.expect(sameTree(sampled.getRoot(), resampled.getRoot(), where), "sampled rebuild, " + build + ": " + where);
+
+    Mat painted(image.size(), image.type(), Scalar::all(0));
+    paintLeaves(reference.getRoot(), painted);
+    Mat reconstruction;
+    reference.reconstructImage(reconstruction);
+    report.expect(norm(painted, reconstruction, NORM_INF) == 0, "reconstructImage, " + build);
+
+    // Leaf errors summed during the build against the painted image
+    Mat diff;
+    absdiff(image, painted, diff);
+    diff.convertTo(diff, CV_64F);
+    Scalar sse = sum(diff.mul(diff));
+    double mse = (sse[0] + sse[1] + sse[2]) / (3.0 * image.total());
+    double buildMse = reference.getBuildStats().getMse();
+    report.expect(near(buildMse, mse), describe("BuildStats::getMse, " + build, Rect(Point(), image.size()), buildMse, mse));
+}
+
+void checkLossless(const Mat& image, DifferentialReport& report) {
+    Quadtree tree(image, 0.0, 1);
+    tree.setLossless(true);
+    tree.buildTree();
+
+    Mat reconstruction;
+    tree.reconstructImage(reconstruction);
+    report.expect(norm(image, reconstruction, NORM_INF) == 0,
+                  "lossless reconstruction, " + to_string(image.cols) + "x" + to_string(image.rows));
+}
+
+static string temporaryContainerPath() {
+    static const string path =
+        (fs::temp_directory_path() / ("qtc_differential_" + to_string(random_device()()) + ".qtc")).string();
+    return path;
+}
+
+void checkContainer(const Mat& image, ErrorMethod method, double threshold, int minBlockSize, bool lossless,
+                    int scale, const Size& outputSize, DifferentialReport& report) {
+    const string build = describeBuild(image, method, threshold, minBlockSize) + (lossless ? ", lossless" : "") +
+                         ", scale " + to_string(scale);
+
+    Quadtree tree(image, threshold, minBlockSize, method);
+    tree.setLossless(lossless);
+    tree.buildTree();
+    tree.setOutputGeometry(scale, outputSize);
+
+    Mat expected;
+    tree.reconstructImage(expected);
+    if (scale > 1) {
+        report.expect(expandScaledImage(expected, scale, outputSize, expected), "scaled geometry, " + build);
+    }
+
+    const string path = temporaryContainerPath();
+    Mat decoded;
+    bool roundTrip = tree.saveContainer(path) && decodeContainer(path, decoded);
+    std::error_code ec;
+    fs::remove(path, ec);
+
+    report.expect(roundTrip, "container round trip, " + build);
+    if (!roundTrip) return;
+    report.expect(decoded.size() == expected.size() && norm(decoded, expected, NORM_INF) == 0,
+                  "decoded container, " + build);
+}
+
+// image as a JPEG with an APP1 Exif segment right after SOI: big-endian TIFF, IFD0 holding
+// only the orientation tag
+static bool writeOrientedJpeg(const Mat& image, int orientation, const string& path) {
+    vector<uchar> jpeg;
+    if (!imencode(".jpg", image, jpeg) || jpeg.size() < 2) return false;
+
+    const uchar app1[] = {0xFF, 0xE1, 0x00, 0x22, 'E', 'x', 'i', 'f', 0, 0,
+                          'M', 'M', 0, '*', 0, 0, 0, 8,
+                          0, 1, 0x01, 0x12, 0, 3, 0, 0, 0, 1, 0, static_cast<uchar>(orientation), 0, 0,
+                          0, 0, 0, 0};
+    jpeg.insert(jpeg.begin() + 2, app1, app1 + sizeof(app1));
+
+    ofstream file(path, ios::binary);
+    file.write(reinterpret_cast<const char*>(jpeg.data()), static_cast<streamsize>(jpeg.size()));
+    return static_cast<bool>(file);
+}
+
+void checkOrientedJpeg(const Mat& image, int orientation, DifferentialReport& report) {
+    const string what = to_string(image.cols) + "x" + to_string(image.rows) + ", orientation " + to_string(orientation);
+    const string path =
+        (fs::temp_directory_path() / ("qtc_differential_" + to_string(random_device()()) + ".jpg")).string();
+    if (!writeOrientedJpeg(image, orientation, path)) return;     // No JPEG encoder in this build
+
+    ImageProbe probe;
+    string error;
+    bool probed = probeImage(path, probe, error);
+    report.expect(probed, "oriented JPEG probe, " + what);
+
+    if (probed) {
+        Size turned = orientation >= 5 ? Size(image.rows, image.cols) : image.size();
+        report.expect(probe.size == turned, "oriented JPEG probe size, " + what);
+
+        for (int scale : {1, 2, 4, 8}) {
+            int applied = 1;
+            Mat decoded = loadImage(path, probe, scale, &applied);
+            Size covered((probe.size.width + applied - 1) / applied, (probe.size.height + applied - 1) / applied);
+            report.expect(!decoded.empty() && decoded.size() == covered,
+                          "oriented JPEG decode at 1/" + to_string(applied) + ", " + what);
+            if (!decoded.empty()) {
+                report.expect(sourceGeometry(probe, decoded, applied) == probe.size,
+                              "oriented JPEG geometry at 1/" + to_string(applied) + ", " + what);
+            }
+        }
+    }
+
+    std::error_code ec;
+    fs::remove(path, ec);
+}
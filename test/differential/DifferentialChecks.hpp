@@ -0,0 +1,58 @@
+#ifndef DIFFERENTIAL_CHECKS_HPP
+#define DIFFERENTIAL_CHECKS_HPP
+
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <string>
+#include <vector>
+#include "Quadtree.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Number of comparisons made and one line per mismatch
+struct DifferentialReport {
+    long long checks = 0;
+    vector<string> failures;
+
+    void expect(bool condition, const string& what) {
+        checks++;
+        if (!condition) failures.push_back(what);
+    }
+    bool ok() const { return failures.empty(); }
+};
+
+// Generated inputs, so nothing outside the repository is needed
+enum class TestPattern { NOISE, FLAT, GRADIENT, BLOCKS, FEW_COLORS };
+const int TEST_PATTERN_COUNT = 5;
+
+Mat makeTestImage(mt19937& rng, Size size, TestPattern pattern);
+// Thresholds in [0, range) cover everything from a full split to a single leaf
+double thresholdRange(ErrorMethod method);
+
+// On one block: BlockMoments, ssimFromMoments and uniformBlockSSIM against calculateVariance,
+// calculateMaxPixelDiff and calculateSSIM; the bounded decisions of errorReachesThreshold and
+// mergedErrorReaches against calculateError (or calculateSSIM) at limits around the value
+void checkBlockMetrics(const Mat& image, const Rect& rect, DifferentialReport& report);
+
+// The recursive top-down build is the reference: the bottom-up and the arena builds must give
+// the same tree, reconstructImage the pixels of painting its leaves one by one, and BuildStats
+// the squared error of that painting. Two sampled builds must agree with each other. Only up to
+// 500k pixels, where no build forces the root to split.
+void checkTreeBuilds(const Mat& image, ErrorMethod method, double threshold, int minBlockSize,
+                     DifferentialReport& report);
+
+// Lossless reconstruction is the source, pixel for pixel
+void checkLossless(const Mat& image, DifferentialReport& report);
+
+// saveContainer then decodeContainer gives reconstructImage, expanded to outputSize when
+// scale > 1 (SCAL chunk). lossless: the run-length coded container instead.
+void checkContainer(const Mat& image, ErrorMethod method, double threshold, int minBlockSize, bool lossless,
+                    int scale, const Size& outputSize, DifferentialReport& report);
+
+// image written as a JPEG with EXIF orientation 1-8: probeImage reports the size imread
+// decodes to (a quarter turn for 5-8), loadImage at every reduced scale covers that size and
+// sourceGeometry gives it back. Skipped when OpenCV has no JPEG encoder.
+void checkOrientedJpeg(const Mat& image, int orientation, DifferentialReport& report);
+
+#endif
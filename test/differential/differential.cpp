@@ -0,0 +1,127 @@
+// Differential runner: random images against the reference paths of the engine.
+//
+//   differential [--iterations N] [--seed S] [--no-huge]
+//
+// Every iteration draws a size (tiny, odd or medium), a pattern, a method, a minimum block
+// size and a threshold, then runs the block, tree, lossless and container checks and writes the
+// image as a JPEG with a random EXIF orientation for the probe and decode checks. One huge
+// image follows unless --no-huge. Exit code 1 on the first mismatching run; the seed and the
+// failing checks are printed so the case can be replayed.
+#include "DifferentialChecks.hpp"
+#include <iostream>
+#include <string>
+
+// Discards the engine logs
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+static Size randomSize(mt19937& rng, int iteration) {
+    // Tiny blocks hit the small-block substitutes, odd sizes the clipped children
+    switch (iteration % 3) {
+        case 0: {
+            uniform_int_distribution<int> side(1, 8);
+            return Size(side(rng), side(rng));
+        }
+        case 1: {
+            uniform_int_distribution<int> side(4, 128);
+            return Size(side(rng) * 2 + 1, side(rng) * 2 + 1);
+        }
+        default: {
+            uniform_int_distribution<int> side(9, 700);
+            return Size(side(rng), side(rng));
+        }
+    }
+}
+
+static Rect randomRect(mt19937& rng, const Size& size) {
+    uniform_int_distribution<int> x(0, size.width - 1), y(0, size.height - 1);
+    int x0 = x(rng), y0 = y(rng);
+    uniform_int_distribution<int> w(1, size.width - x0), h(1, size.height - y0);
+    return Rect(x0, y0, w(rng), h(rng));
+}
+
+// Output geometry of a source decoded at 1/scale: anything that rounds up to the source size
+static Size randomOutputSize(mt19937& rng, const Size& size, int scale) {
+    uniform_int_distribution<int> extraW(0, scale - 1), extraH(0, scale - 1);
+    return Size((size.width - 1) * scale + 1 + extraW(rng), (size.height - 1) * scale + 1 + extraH(rng));
+}
+
+static void runContainerChecks(mt19937& rng, const Mat& image, ErrorMethod method, double threshold,
+                               int minBlockSize, DifferentialReport& report) {
+    const int scales[] = {1, 2, 4};
+    int scale = scales[uniform_int_distribution<int>(0, 2)(rng)];
+    Size outputSize = scale > 1 ? randomOutputSize(rng, image.size(), scale) : image.size();
+
+    checkContainer(image, method, threshold, minBlockSize, false, scale, outputSize, report);
+    checkContainer(image, method, threshold, minBlockSize, true, 1, image.size(), report);
+}
+
+int main(int argc, char** argv) {
+    int iterations = 200;
+    unsigned int seed = random_device()();
+    bool huge = true;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = stoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned int>(stoul(argv[++i]));
+        } else if (arg == "--no-huge") {
+            huge = false;
+        } else {
+            cerr << "Usage: differential [--iterations N] [--seed S] [--no-huge]" << endl;
+            return 2;
+        }
+    }
+
+    // The engine logs every build; only the report is of interest here
+    NullBuffer discard;
+    streambuf* console = cout.rdbuf();
+    cout.rdbuf(&discard);
+
+    mt19937 rng(seed);
+    DifferentialReport report;
+    const int minBlockSizes[] = {1, 2, 3, 4, 8};
+    const ErrorMethod methods[] = {ErrorMethod::VARIANCE, ErrorMethod::MAD, ErrorMethod::MAX_PIXEL_DIFF,
+                                   ErrorMethod::ENTROPY, ErrorMethod::SSIM, ErrorMethod::EDGE_AWARE};
+
+    for (int iteration = 0; iteration < iterations && report.ok(); iteration++) {
+        Size size = randomSize(rng, iteration);
+        TestPattern pattern = static_cast<TestPattern>(uniform_int_distribution<int>(0, TEST_PATTERN_COUNT - 1)(rng));
+        Mat image = makeTestImage(rng, size, pattern);
+
+        ErrorMethod method = methods[uniform_int_distribution<int>(0, 5)(rng)];
+        int minBlockSize = minBlockSizes[uniform_int_distribution<int>(0, 4)(rng)];
+        double threshold = uniform_real_distribution<double>(0.0, thresholdRange(method))(rng);
+
+        checkBlockMetrics(image, Rect(Point(), size), report);
+        for (int k = 0; k < 4; k++) {
+            checkBlockMetrics(image, randomRect(rng, size), report);
+        }
+        checkTreeBuilds(image, method, threshold, minBlockSize, report);
+        checkLossless(image, report);
+        runContainerChecks(rng, image, method, threshold, minBlockSize, report);
+        checkOrientedJpeg(image, uniform_int_distribution<int>(1, 8)(rng), report);
+    }
+
+    // Above 500k pixels the builds fan out; trees then differ by design, the output may not
+    if (huge && report.ok()) {
+        Mat image = makeTestImage(rng, Size(2051, 1543), TestPattern::BLOCKS);
+        double threshold = uniform_real_distribution<double>(0.0, thresholdRange(ErrorMethod::VARIANCE))(rng);
+
+        checkBlockMetrics(image, Rect(0, 0, 1024, 1024), report);
+        checkBlockMetrics(image, Rect(1023, 771, 1028, 772), report);
+        checkLossless(image, report);
+        runContainerChecks(rng, image, ErrorMethod::VARIANCE, threshold, 4, report);
+    }
+
+    cout.rdbuf(console);
+    cout << "Seed " << seed << ": " << report.checks << " checks, " << report.failures.size() << " failed" << endl;
+    for (const string& failure : report.failures) {
+        cout << "  " << failure << endl;
+    }
+    return report.ok() ? 0 : 1;
+}
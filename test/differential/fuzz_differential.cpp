@@ -0,0 +1,47 @@
+// libFuzzer target over the same checks as the differential runner, without file IO.
+// Input layout: width, height, method, minimum block size, two threshold bytes, then the
+// pixels (BGR, repeated when the input is short). Build with -DQTC_FUZZ=ON and clang.
+#include "DifferentialChecks.hpp"
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    cout.setstate(ios::badbit);     // Engine logs cost more than the checks
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    const size_t HEADER = 6;
+    if (size < HEADER) return 0;
+
+    const ErrorMethod methods[] = {ErrorMethod::VARIANCE, ErrorMethod::MAD, ErrorMethod::MAX_PIXEL_DIFF,
+                                   ErrorMethod::ENTROPY, ErrorMethod::SSIM, ErrorMethod::EDGE_AWARE};
+    const int minBlockSizes[] = {1, 2, 3, 4, 8};
+
+    int width = data[0] % 96 + 1;
+    int height = data[1] % 96 + 1;
+    ErrorMethod method = methods[data[2] % 6];
+    int minBlockSize = minBlockSizes[data[3] % 5];
+    double threshold = thresholdRange(method) * ((data[4] << 8) | data[5]) / 65536.0;
+
+    Mat image(height, width, CV_8UC3, Scalar::all(0));
+    size_t pixelBytes = size - HEADER;
+    if (pixelBytes > 0) {
+        uchar* pixels = image.ptr<uchar>(0);
+        for (size_t i = 0; i < image.total() * 3; i++) pixels[i] = data[HEADER + i % pixelBytes];
+    }
+
+    DifferentialReport report;
+    checkBlockMetrics(image, Rect(0, 0, width, height), report);
+    checkBlockMetrics(image, Rect(width / 3, height / 3, width - width / 3, height - height / 3), report);
+    checkTreeBuilds(image, method, threshold, minBlockSize, report);
+    checkLossless(image, report);
+
+    if (!report.ok()) {
+        for (const string& failure : report.failures) {
+            cerr << failure << endl;
+        }
+        abort();
+    }
+    return 0;
+}